@@ -0,0 +1,27 @@
+#!/bin/bash
+
+# This script checks a surface grasp under uncertainty. The noise-free
+# trajectory ends on the green object, and 50 particles repeat it with
+# initial and motion noise. The response reports how many of them still
+# end on the green object without touching anything else.
+rosservice call /check_kinematics_belief "
+initial_configuration: [0, 0.1, 0, 2.3, 0, 0.5, 0]
+goal_pose:
+  position: {x: 0.4, y: -0.02, z: 0.25}
+  orientation: {x: 0.997, y: 0, z: 0.071, w: 0}
+ifco_pose:
+  position: {x: -0.12, y: 0, z: 0.1}
+  orientation: {x: 0.0, y: 0.0, z: 0.0, w: 1}
+bounding_boxes_with_poses:
+- box:
+    type: 0
+    dimensions: [0.08, 0.08, 0.08]
+  pose:
+    position: {x: 0.4, y: -0.02, z: 0.25}
+    orientation: {x: 0.0, y: 0.0, z: 0.0, w: 1.0}
+allowed_collisions:
+- {type: 1, box_id: 0, terminate_on_collision: true}
+number_of_particles: 50
+initial_std_error: [0.005, 0.005, 0.005, 0.005, 0.005, 0.005, 0.005]
+joints_std_error: [0.001, 0.001, 0.001, 0.001, 0.001, 0.001, 0.001]
+"
@@ -0,0 +1,32 @@
+#!/bin/bash
+
+# This script plans with CERRT to a belief where both fingers touch the
+# green object. Planning stops after 30 seconds at the latest and returns
+# the path to the best belief found so far. The tree is kept, calling the
+# script again continues from it.
+rosservice call /plan_cerrt "
+initial_configuration: [0.1, 0.1, 0, 2.3, 0, 0.5, 0]
+goal_pose:
+  position: {x: 0.45, y: 0.10, z: 0.35}
+  orientation: {x: 0.997, y: 0, z: 0.071, w: 0}
+ifco_pose:
+  position: {x: -0.12, y: 0, z: 0.1}
+  orientation: {x: 0.0, y: 0.0, z: 0.0, w: 1}
+bounding_boxes_with_poses:
+- box:
+    type: 0
+    dimensions: [0.08, 0.08, 0.08]
+  pose:
+    position: {x: 0.45, y: 0.10, z: 0.25}
+    orientation: {x: 0.0, y: 0.0, z: 0.0, w: 1.0}
+min_position_deltas: [-0.03, -0.03, -0.02]
+max_position_deltas: [0.03, 0.03, 0.02]
+min_orientation_deltas: [-0.2, -0.2, -0.5]
+max_orientation_deltas: [0.2, 0.2, 0.5]
+goal_bias: 0.3
+required_goal_contacts:
+- {robot_part: 'sensor_Finger1', type: 1, box_id: 0}
+- {robot_part: 'sensor_Finger2', type: 1, box_id: 0}
+time_budget: 30
+warm_start: true
+"
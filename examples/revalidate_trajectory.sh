@@ -0,0 +1,60 @@
+#!/bin/bash
+
+# This script checks a trajectory to a pregrasp pose with check_kinematics
+# and then checks it again after the red object was moved, without running
+# the jacobian control again. Only the steps close to the red object before
+# or after the move are queried for collisions.
+result=$(rosservice call /check_kinematics "
+initial_configuration: [0.1, 0.1, 0, 2.3, 0, 0.5, 0]
+goal_pose:
+  position: {x: 0.45, y: 0.10, z: 0.35}
+  orientation: {x: 0.6830127, y: -0.6830127, z: 0.1830127, w: 0.1830127}
+ifco_pose:
+  position: {x: -0.12, y: 0, z: 0.1}
+  orientation: {x: 0.0, y: 0.0, z: 0.0, w: 1}
+bounding_boxes_with_poses:
+- box:
+    type: 0
+    dimensions: [0.08, 0.08, 0.08]
+  pose:
+    position: {x: 0.6, y: -0.2, z: 0.3}
+    orientation: {x: 0.0, y: 0.0, z: 0.0, w: 1.0}
+min_position_deltas: [-0.05, -0.05, -0.05]
+max_position_deltas: [0.05, 0.05, 0.05]
+min_orientation_deltas: [0, 0, 0]
+max_orientation_deltas: [0, 0, 0]
+allowed_collisions:
+- {type: 2, constraint_name: 'bottom', terminate_on_collision: true}
+"
+)
+
+echo $result
+
+trajectory=$(echo $result | perl -n -e'/trajectory: (\[[^]]*\])/ && print $1')
+
+rosservice call /revalidate_trajectory "
+trajectory: $trajectory
+ifco_pose:
+  position: {x: -0.12, y: 0, z: 0.1}
+  orientation: {x: 0.0, y: 0.0, z: 0.0, w: 1}
+bounding_boxes_with_poses:
+- box:
+    type: 0
+    dimensions: [0.08, 0.08, 0.08]
+  pose:
+    position: {x: 0.55, y: -0.1, z: 0.3}
+    orientation: {x: 0.0, y: 0.0, z: 0.0, w: 1.0}
+allowed_collisions:
+- {type: 2, constraint_name: 'bottom', terminate_on_collision: true}
+incremental: true
+previous_ifco_pose:
+  position: {x: -0.12, y: 0, z: 0.1}
+  orientation: {x: 0.0, y: 0.0, z: 0.0, w: 1}
+previous_bounding_boxes_with_poses:
+- box:
+    type: 0
+    dimensions: [0.08, 0.08, 0.08]
+  pose:
+    position: {x: 0.6, y: -0.2, z: 0.3}
+    orientation: {x: 0.0, y: 0.0, z: 0.0, w: 1.0}
+"
@@ -0,0 +1,71 @@
+#ifndef AABB_H
+#define AABB_H
+
+#include <limits>
+#include <rl/kin/Kinematics.h>
+#include <rl/math/Transform.h>
+#include <rl/math/Vector.h>
+
+/* An axis aligned bounding box in the robot base frame. The default box is empty, it contains no point and intersects
+ * no box until it is extended.
+ */
+struct Aabb
+{
+  rl::math::Vector3 minimum = rl::math::Vector3::Constant(std::numeric_limits<rl::math::Real>::infinity());
+  rl::math::Vector3 maximum = rl::math::Vector3::Constant(-std::numeric_limits<rl::math::Real>::infinity());
+
+  /* The bounds of a box with the given full dimensions at pose. */
+  static Aabb ofBox(const rl::math::Transform& pose, const rl::math::Vector3& dimensions)
+  {
+    rl::math::Vector3 extents = pose.linear().cwiseAbs() * (dimensions / 2);
+
+    Aabb aabb;
+    aabb.minimum = pose.translation() - extents;
+    aabb.maximum = pose.translation() + extents;
+    return aabb;
+  }
+
+  /* The bounds of the frame origins of kinematics in its current state, grown by margin to cover the links. The reach
+   * of the links from their frame origins is given by robotLinkReach.
+   */
+  static Aabb ofFrames(const rl::kin::Kinematics& kinematics, rl::math::Real margin)
+  {
+    Aabb aabb;
+    for (std::size_t i = 0; i < kinematics.getFrames(); ++i)
+      aabb.extend(kinematics.getFrame(i).translation());
+
+    return aabb.grown(margin);
+  }
+
+  bool empty() const
+  {
+    return (minimum.array() > maximum.array()).any();
+  }
+
+  void extend(const rl::math::Vector3& point)
+  {
+    minimum = minimum.cwiseMin(point);
+    maximum = maximum.cwiseMax(point);
+  }
+
+  void extend(const Aabb& other)
+  {
+    minimum = minimum.cwiseMin(other.minimum);
+    maximum = maximum.cwiseMax(other.maximum);
+  }
+
+  Aabb grown(rl::math::Real margin) const
+  {
+    Aabb aabb = *this;
+    aabb.minimum.array() -= margin;
+    aabb.maximum.array() += margin;
+    return aabb;
+  }
+
+  bool intersects(const Aabb& other) const
+  {
+    return (minimum.array() <= other.maximum.array()).all() && (other.minimum.array() <= maximum.array()).all();
+  }
+};
+
+#endif  // AABB_H
@@ -0,0 +1,299 @@
+#include <algorithm>
+#include <cmath>
+#include <array>
+#include <utility>
+#include "approach_roadmap.h"
+#include "collision_types.h"
+#include "jacobian_controller.h"
+
+namespace
+{
+typedef std::vector<rl::math::Vector> Trajectory;
+
+/* Append a trajectory that starts where trajectory ends. */
+void append(Trajectory& trajectory, const Trajectory& continuation)
+{
+  trajectory.insert(trajectory.end(), continuation.begin() + (trajectory.empty() ? 0 : 1), continuation.end());
+}
+
+/* Whether a failed rollout touched something, so that it can succeed when the bounding boxes change. */
+bool failedOnCollision(const JacobianController::SingleResult& result)
+{
+  using Outcome = JacobianController::SingleResult::Outcome;
+  return result.outcomes.count(Outcome::UNACCEPTABLE_COLLISION) ||
+         result.outcomes.count(Outcome::UNSENSORIZED_COLLISION) ||
+         result.outcomes.count(Outcome::MISSED_REQUIRED_COLLISIONS);
+}
+
+/* The axis aligned bounds of a part in the frame of the model. */
+void partBounds(const ApproachRoadmap::Part& part, rl::math::Vector3& minimum, rl::math::Vector3& maximum)
+{
+  rl::math::Vector3 half_extents = part.pose.linear().cwiseAbs() * part.dimensions / 2;
+  minimum = part.pose.translation() - half_extents;
+  maximum = part.pose.translation() + half_extents;
+}
+
+/* Nothing may be touched on the edges of the roadmap. */
+const WorldCollisionTypes no_collisions{ WorldCollisionTypes::PartToCollisionType() };
+}  // namespace
+
+constexpr std::size_t ApproachRoadmap::Node::no_parent;
+
+boost::optional<ApproachRoadmap::Container> ApproachRoadmap::Container::fromParts(const std::vector<Part>& parts)
+{
+  rl::math::Vector3 minimum, maximum;
+
+  const Part* bottom = nullptr;
+  rl::math::Real bottom_area = 0;
+  for (auto& part : parts)
+  {
+    partBounds(part, minimum, maximum);
+    rl::math::Vector3 extents = maximum - minimum;
+    rl::math::Vector3::Index thinnest;
+    extents.minCoeff(&thinnest);
+    if (thinnest == 2 && extents.x() * extents.y() > bottom_area)
+    {
+      bottom = &part;
+      bottom_area = extents.x() * extents.y();
+    }
+  }
+
+  if (!bottom)
+    return boost::none;
+
+  rl::math::Vector3 bottom_minimum, bottom_maximum;
+  partBounds(*bottom, bottom_minimum, bottom_maximum);
+  rl::math::Vector3 middle = (bottom_minimum + bottom_maximum) / 2;
+
+  // the inner faces of the nearest walls on the sides -x, +x, -y and +y, and the lowest rim
+  std::array<const Part*, 4> walls = { { nullptr, nullptr, nullptr, nullptr } };
+  std::array<rl::math::Real, 4> faces;
+  rl::math::Real rim = std::numeric_limits<rl::math::Real>::max();
+  for (auto& part : parts)
+  {
+    partBounds(part, minimum, maximum);
+    rl::math::Vector3 extents = maximum - minimum;
+    rl::math::Vector3::Index thinnest;
+    extents.minCoeff(&thinnest);
+    if (&part == bottom || thinnest == 2)
+      continue;
+
+    auto axis = static_cast<int>(thinnest);
+    bool positive = (minimum[axis] + maximum[axis]) / 2 > middle[axis];
+    auto side = 2 * axis + (positive ? 1 : 0);
+    rl::math::Real face = positive ? minimum[axis] : maximum[axis];
+    if (!walls[side] || std::abs(face - middle[axis]) < std::abs(faces[side] - middle[axis]))
+    {
+      walls[side] = &part;
+      faces[side] = face;
+    }
+  }
+
+  Container container;
+  for (std::size_t side = 0; side < walls.size(); ++side)
+  {
+    if (!walls[side])
+      return boost::none;
+
+    partBounds(*walls[side], minimum, maximum);
+    rim = std::min(rim, maximum.z());
+    container.wall_names[side] = walls[side]->name;
+  }
+
+  container.bottom_name = bottom->name;
+  container.bottom_center = rl::math::Vector3((faces[0] + faces[1]) / 2, (faces[2] + faces[3]) / 2, bottom_maximum.z());
+  container.inner_dimensions = rl::math::Vector3(faces[1] - faces[0], faces[3] - faces[2], rim - bottom_maximum.z());
+  if ((container.inner_dimensions.array() <= 0).any())
+    return boost::none;
+
+  return container;
+}
+
+ApproachRoadmap::ApproachRoadmap(const Container& container, const rl::math::Quaternion& approach_orientation,
+                                 double clearance, double inset)
+  : approach_orientation_(approach_orientation)
+  , ifco_parts_(container.wall_names.begin(), container.wall_names.end())
+{
+  ifco_parts_.push_back(container.bottom_name);
+
+  rl::math::Vector3 half_extents = container.inner_dimensions / 2;
+  rl::math::Real above = container.inner_dimensions.z() + clearance;
+
+  auto root = addNode("above", container.bottom_center + rl::math::Vector3(0, 0, above), Node::no_parent);
+  addNode("inside_center", container.bottom_center + rl::math::Vector3(0, 0, inset), root);
+
+  // the nodes along the walls are named after them, the corners after the walls along y and x
+  auto& names = container.wall_names;
+  const std::array<std::pair<std::string, std::array<int, 2>>, 8> sides = {
+    { { names[0], { { -1, 0 } } },
+      { names[1], { { 1, 0 } } },
+      { names[2], { { 0, -1 } } },
+      { names[3], { { 0, 1 } } },
+      { names[2] + "_" + names[0], { { -1, -1 } } },
+      { names[2] + "_" + names[1], { { 1, -1 } } },
+      { names[3] + "_" + names[0], { { -1, 1 } } },
+      { names[3] + "_" + names[1], { { 1, 1 } } } }
+  };
+
+  for (auto& side : sides)
+  {
+    rl::math::Vector3 offset(side.second[0] * std::max<rl::math::Real>(half_extents.x() - inset, 0),
+                             side.second[1] * std::max<rl::math::Real>(half_extents.y() - inset, 0), 0);
+
+    auto above_side = addNode("above_" + side.first,
+                              container.bottom_center + offset + rl::math::Vector3(0, 0, above), root);
+    addNode("inside_" + side.first, container.bottom_center + offset + rl::math::Vector3(0, 0, inset), above_side);
+  }
+}
+
+std::size_t ApproachRoadmap::addNode(const std::string& name, const rl::math::Vector3& position, std::size_t parent)
+{
+  Node node;
+  node.name = name;
+  node.pose = rl::math::Transform::Identity();
+  node.pose.linear() = approach_orientation_.toRotationMatrix();
+  node.pose.translation() = position;
+  node.parent = parent;
+
+  nodes_.push_back(node);
+  return nodes_.size() - 1;
+}
+
+std::vector<std::size_t> ApproachRoadmap::path(std::size_t node) const
+{
+  std::vector<std::size_t> nodes;
+  for (; node != Node::no_parent; node = nodes_[node].parent)
+    nodes.push_back(node);
+
+  std::reverse(nodes.begin(), nodes.end());
+  return nodes;
+}
+
+bool ApproachRoadmap::isIfcoPart(const std::string& name) const
+{
+  return std::find(ifco_parts_.begin(), ifco_parts_.end(), name) != ifco_parts_.end();
+}
+
+std::vector<std::size_t> ApproachRoadmap::nearest(const rl::math::Transform& ifco_pose,
+                                                  const rl::math::Transform& target_pose, std::size_t count,
+                                                  double rotation_weight) const
+{
+  std::vector<std::pair<rl::math::Real, std::size_t>> distances;
+  for (std::size_t i = 0; i < nodes_.size(); ++i)
+  {
+    rl::math::Transform pose = ifco_pose * nodes_[i].pose;
+    rl::math::Real rotation = rl::math::AngleAxis(pose.linear().transpose() * target_pose.linear()).angle();
+    distances.emplace_back((pose.translation() - target_pose.translation()).norm() + rotation_weight * rotation, i);
+  }
+
+  count = std::min(count, distances.size());
+  std::partial_sort(distances.begin(), distances.begin() + count, distances.end());
+
+  std::vector<std::size_t> nodes;
+  for (std::size_t i = 0; i < count; ++i)
+    nodes.push_back(distances[i].second);
+
+  return nodes;
+}
+
+ApproachMotions::ApproachMotions(std::shared_ptr<const ApproachRoadmap> roadmap, const rl::math::Transform& ifco_pose)
+  : roadmap_(roadmap)
+  , ifco_pose_(ifco_pose)
+  , edges_(roadmap->nodes().size(), Edge::UNKNOWN)
+  , trajectories_(roadmap->nodes().size())
+{
+}
+
+boost::optional<std::vector<rl::math::Vector>> ApproachMotions::connect(JacobianController& controller,
+                                                                        std::size_t node,
+                                                                        const rl::math::Vector& initial_configuration)
+{
+  auto nodes = roadmap_->path(node);
+
+  auto trajectory = connectRoot(controller, initial_configuration);
+  if (!trajectory)
+    return boost::none;
+
+  for (std::size_t i = 1; i < nodes.size(); ++i)
+  {
+    auto child = nodes[i];
+    auto& parent_configuration = trajectories_[nodes[i - 1]].back();
+
+    if (edges_[child] == Edge::UNREACHABLE)
+      return boost::none;
+
+    if (edges_[child] == Edge::VERIFIED)
+    {
+      if (!controller.checkTrajectory(trajectories_[child], no_collisions))
+        return boost::none;
+    }
+    else
+    {
+      auto result = controller.moveSingleParticle(parent_configuration, pose(child), no_collisions);
+      if (!result)
+      {
+        // the parent configuration is fixed, so only a collision with a bounding box can be gone in another request
+        if (!failedOnCollision(result) || touchesIfco(controller, result))
+          edges_[child] = Edge::UNREACHABLE;
+        return boost::none;
+      }
+
+      edges_[child] = Edge::VERIFIED;
+      trajectories_[child] = result.trajectory;
+    }
+
+    append(*trajectory, trajectories_[child]);
+  }
+
+  return trajectory;
+}
+
+bool ApproachMotions::touchesIfco(JacobianController& controller, const JacobianController::SingleResult& result) const
+{
+  // a failed rollout ends in the configuration it failed in
+  if (result.trajectory.empty())
+    return false;
+
+  for (auto& contact : controller.contactsAt(result.trajectory.back()))
+  {
+    if (roadmap_->isIfcoPart(contact.second))
+      return true;
+  }
+
+  return false;
+}
+
+boost::optional<std::vector<rl::math::Vector>>
+ApproachMotions::connectRoot(JacobianController& controller, const rl::math::Vector& initial_configuration)
+{
+  const std::size_t root = 0;
+
+  // the first request fixes the configuration of the root, the edges below it start there
+  if (edges_[root] != Edge::VERIFIED)
+  {
+    auto result = controller.moveSingleParticle(initial_configuration, pose(root), no_collisions);
+    if (!result)
+      return boost::none;
+
+    edges_[root] = Edge::VERIFIED;
+    trajectories_[root] = result.trajectory;
+    return result.trajectory;
+  }
+
+  auto& root_configuration = trajectories_[root].back();
+  auto direct = controller.moveJoints(initial_configuration, root_configuration, no_collisions);
+  if (direct)
+    return direct.trajectory;
+
+  // the robot is redundant, a rollout to the root pose can end in another configuration than the stored one
+  auto result = controller.moveSingleParticle(initial_configuration, pose(root), no_collisions);
+  if (!result)
+    return boost::none;
+
+  auto to_root_configuration = controller.moveJoints(result.trajectory.back(), root_configuration, no_collisions);
+  if (!to_root_configuration)
+    return boost::none;
+
+  append(result.trajectory, to_root_configuration.trajectory);
+  return result.trajectory;
+}
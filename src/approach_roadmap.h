@@ -0,0 +1,138 @@
+#ifndef APPROACH_ROADMAP_H
+#define APPROACH_ROADMAP_H
+
+#include <array>
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+#include <boost/optional.hpp>
+#include <rl/math/Rotation.h>
+#include <rl/math/Transform.h>
+#include <rl/math/Vector.h>
+#include "jacobian_controller.h"
+
+/* Approach poses of the end effector in the frame of the IFCO model: above the opening, above and inside the IFCO
+ * along every wall and in every corner, and above the middle of the bottom. The IFCO is rigid, so the poses are built
+ * once and only moved with the IFCO. The nodes form a tree whose root, the first node, is above the opening. The
+ * parent of a node inside the IFCO is the node above it.
+ */
+class ApproachRoadmap
+{
+public:
+  /* A box shape of the IFCO model, in the frame of the model. */
+  struct Part
+  {
+    std::string name;
+    rl::math::Transform pose;
+    rl::math::Vector3 dimensions;
+  };
+
+  /* The inside of the IFCO, axis aligned in the frame of the model. */
+  struct Container
+  {
+    /* The middle of the upper surface of the bottom. */
+    rl::math::Vector3 bottom_center;
+    /* Inner length along x, width along y and height of the walls above the bottom. */
+    rl::math::Vector3 inner_dimensions;
+    /* The shape names of the walls at -x, +x, -y and +y, and of the bottom. */
+    std::array<std::string, 4> wall_names;
+    std::string bottom_name;
+
+    /* The inside bounded by the parts of a model: the bottom is the largest part that is thinnest along z, the walls
+     * are the parts thinnest along x or y nearest to the middle of the bottom on either side. None if a wall is
+     * missing.
+     */
+    static boost::optional<Container> fromParts(const std::vector<Part>& parts);
+  };
+
+  struct Node
+  {
+    static constexpr std::size_t no_parent = std::numeric_limits<std::size_t>::max();
+
+    std::string name;
+    /* The pose of the end effector in the frame of the IFCO. */
+    rl::math::Transform pose;
+    std::size_t parent;
+  };
+
+  /* @param approach_orientation The orientation of the end effector at every node, in the frame of the IFCO.
+   * @param clearance The height of the nodes above the opening over the rim of the walls.
+   * @param inset The distance of the nodes inside the IFCO from the walls and from the bottom.
+   */
+  ApproachRoadmap(const Container& container, const rl::math::Quaternion& approach_orientation, double clearance,
+                  double inset);
+
+  const std::vector<Node>& nodes() const
+  {
+    return nodes_;
+  }
+
+  /* The nodes from the root to node. */
+  std::vector<std::size_t> path(std::size_t node) const;
+
+  /* Whether name is the shape name of a wall or of the bottom of the IFCO. */
+  bool isIfcoPart(const std::string& name) const;
+
+  /* At most count nodes, ordered by the distance of their pose in an IFCO at ifco_pose to target_pose. A radian of
+   * rotation counts as much as rotation_weight metres of translation.
+   */
+  std::vector<std::size_t> nearest(const rl::math::Transform& ifco_pose, const rl::math::Transform& target_pose,
+                                   std::size_t count, double rotation_weight = 0.1) const;
+
+private:
+  std::size_t addNode(const std::string& name, const rl::math::Vector3& position, std::size_t parent);
+
+  rl::math::Quaternion approach_orientation_;
+  std::vector<std::string> ifco_parts_;
+  std::vector<Node> nodes_;
+};
+
+/* The motions along the edges of an approach roadmap for one IFCO pose. An edge that was rolled out successfully
+ * keeps its trajectory and is only checked again when it is reused, the bounding boxes may have changed since. An
+ * edge whose rollout failed without a collision, or on a collision with the IFCO itself, cannot be done from its parent
+ * configuration at all and is not tried again. The edges are rolled out and checked without allowing any collision.
+ */
+class ApproachMotions
+{
+public:
+  ApproachMotions(std::shared_ptr<const ApproachRoadmap> roadmap, const rl::math::Transform& ifco_pose);
+
+  /* A trajectory from initial_configuration to the configuration of node that was checked in the current scene of
+   * controller, or none if there is no such trajectory through the roadmap.
+   */
+  boost::optional<std::vector<rl::math::Vector>> connect(JacobianController& controller, std::size_t node,
+                                                         const rl::math::Vector& initial_configuration);
+
+  /* The pose of a node in the frame of the robot. */
+  rl::math::Transform pose(std::size_t node) const
+  {
+    return ifco_pose_ * roadmap_->nodes()[node].pose;
+  }
+
+private:
+  enum class Edge
+  {
+    UNKNOWN,
+    VERIFIED,
+    UNREACHABLE
+  };
+
+  /* The part of a trajectory into the root, which is reached from the configuration of a request. */
+  boost::optional<std::vector<rl::math::Vector>> connectRoot(JacobianController& controller,
+                                                             const rl::math::Vector& initial_configuration);
+
+  /* Whether a failed rollout ended in contact with a wall or the bottom of the IFCO, which does not move away. */
+  bool touchesIfco(JacobianController& controller, const JacobianController::SingleResult& result) const;
+
+  std::shared_ptr<const ApproachRoadmap> roadmap_;
+  rl::math::Transform ifco_pose_;
+
+  /* The state of the edge from the parent into every node, and its trajectory if it was verified. The edge into the
+   * root starts at the configuration of the request it was first rolled out in.
+   */
+  std::vector<Edge> edges_;
+  std::vector<std::vector<rl::math::Vector>> trajectories_;
+};
+
+#endif  // APPROACH_ROADMAP_H
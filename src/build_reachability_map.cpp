@@ -0,0 +1,167 @@
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+#include <rl/kin/Kinematics.h>
+#include "reachability_map.h"
+
+// the manipulability below which JacobianController reports a singularity
+const double singularity_threshold = 1.0e-3;
+
+/* Call visit for the bins next to bin, one step away in the position of the voxel, in the approach direction on the
+ * same face of the cube or in the roll, which wraps around.
+ */
+template <class Visit> void forEachNeighbour(const ReachabilityMap::Layout& layout, std::size_t bin, Visit visit)
+{
+  // the digits of the bin, from the least significant: roll, v, u, face, then x, y and z of the voxel
+  std::array<std::size_t, 7> radices = { layout.roll_bins, layout.direction_bins, layout.direction_bins, 6,
+                                         layout.cells[0],  layout.cells[1],         layout.cells[2] };
+  std::array<std::size_t, 7> digits;
+  auto rest = bin;
+  for (std::size_t i = 0; i < radices.size(); ++i)
+  {
+    digits[i] = rest % radices[i];
+    rest /= radices[i];
+  }
+
+  std::size_t weight = 1;
+  for (std::size_t i = 0; i < radices.size(); weight *= radices[i], ++i)
+  {
+    // the faces are not neighbours of each other along their digit
+    if (i == 3)
+      continue;
+
+    if (digits[i] > 0)
+      visit(bin - weight);
+    else if (i == 0 && radices[i] > 2)
+      visit(bin + (radices[i] - 1) * weight);
+
+    if (digits[i] + 1 < radices[i])
+      visit(bin + weight);
+    else if (i == 0 && radices[i] > 2)
+      visit(bin - (radices[i] - 1) * weight);
+  }
+}
+
+/* Build a reachability map for the end effector of a kinematics file by forward kinematics of uniformly sampled
+ * configurations within the joint limits. Configurations near a singularity do not count, the jacobian controller
+ * fails there. The samples are sparse compared to the bins, so the bins next to a reached bin are marked reachable as
+ * well, a capability of 0 means that no sample fell into the bin or next to it. The coverage of the sampling is
+ * printed, a large share of bins reached by a single sample means that more samples are needed.
+ *
+ * usage: build_reachability_map kinematics_file map_file [samples] [voxel_size] [direction_bins] [roll_bins]
+ */
+int main(int argc, char** argv)
+{
+  if (argc < 3)
+  {
+    std::cerr << "usage: " << argv[0]
+              << " kinematics_file map_file [samples=10000000] [voxel_size=0.05] [direction_bins=3] [roll_bins=6]"
+              << std::endl;
+    return -1;
+  }
+
+  try
+  {
+    std::unique_ptr<rl::kin::Kinematics> kinematics(rl::kin::Kinematics::create(argv[1]));
+    std::size_t samples = argc > 3 ? std::stoul(argv[3]) : 10000000;
+
+    ReachabilityMap::Layout layout;
+    layout.voxel_size = argc > 4 ? std::stod(argv[4]) : 0.05;
+    layout.direction_bins = argc > 5 ? std::stoul(argv[5]) : 3;
+    layout.roll_bins = argc > 6 ? std::stoul(argv[6]) : 6;
+
+    rl::math::Vector minimum, maximum;
+    kinematics->getMinimum(minimum);
+    kinematics->getMaximum(maximum);
+
+    // the voxels cover a cube around the first frame with the sum of the distances between the frame origins, which
+    // the joints do not change, as half of its side
+    rl::math::Vector configuration = (minimum + maximum) / 2;
+    kinematics->setPosition(configuration);
+    kinematics->updateFrames();
+    double reach = 0;
+    for (std::size_t i = 1; i < kinematics->getFrames(); ++i)
+      reach += (kinematics->getFrame(i).translation() - kinematics->getFrame(i - 1).translation()).norm();
+
+    layout.origin = (kinematics->getFrame(0).translation().array() - reach).matrix();
+    for (auto& cells : layout.cells)
+      cells = static_cast<std::uint32_t>(std::ceil(2 * reach / layout.voxel_size));
+
+    std::cout << "Sampling " << samples << " configurations into " << layout.size() << " bins" << std::endl;
+    std::vector<std::uint32_t> counts(layout.size(), 0);
+    std::mt19937 engine(1);
+    std::uniform_real_distribution<double> random_01;
+    for (std::size_t i = 0; i < samples; ++i)
+    {
+      for (std::size_t j = 0; j < kinematics->getDof(); ++j)
+        configuration(j) = minimum(j) + random_01(engine) * (maximum(j) - minimum(j));
+
+      kinematics->setPosition(configuration);
+      kinematics->updateFrames();
+      kinematics->updateJacobian();
+      if (kinematics->getDof() > 3 && kinematics->calculateManipulabilityMeasure() < singularity_threshold)
+        continue;
+
+      auto bin = layout.index(kinematics->forwardPosition());
+      if (bin != ReachabilityMap::Layout::outside)
+        ++counts[bin];
+    }
+
+    // the capability grows with the logarithm of the count, a few samples in a bin already mean it is reachable
+    auto maximum_count = *std::max_element(counts.begin(), counts.end());
+    std::vector<std::uint8_t> capabilities(counts.size(), 0);
+    std::size_t counted_samples = 0;
+    std::size_t reached = 0;
+    std::size_t reached_once = 0;
+    for (std::size_t i = 0; i < counts.size(); ++i)
+    {
+      if (counts[i] == 0)
+        continue;
+
+      capabilities[i] = static_cast<std::uint8_t>(1 + 254 * std::log(counts[i]) / std::log(maximum_count + 1.0));
+      counted_samples += counts[i];
+      ++reached;
+      if (counts[i] == 1)
+        ++reached_once;
+    }
+
+    std::size_t dilated = 0;
+    for (std::size_t i = 0; i < counts.size(); ++i)
+    {
+      if (counts[i] == 0)
+        continue;
+
+      forEachNeighbour(layout, i, [&capabilities, &dilated](std::size_t neighbour) {
+        if (capabilities[neighbour] == 0)
+        {
+          capabilities[neighbour] = 1;
+          ++dilated;
+        }
+      });
+    }
+
+    // the share of samples that fell into a bin of their own estimates the chance that the next sample would reach a
+    // bin no sample reached so far (Good-Turing)
+    std::cout << counted_samples << " samples were away from singularities and inside the voxels" << std::endl;
+    std::cout << reached << " of " << counts.size() << " bins were reached, " << reached_once
+              << " of them by a single sample" << std::endl;
+    std::cout << "Estimated chance that another sample reaches a new bin: "
+              << (counted_samples ? static_cast<double>(reached_once) / counted_samples : 1.0) << std::endl;
+    std::cout << dilated << " bins next to reached ones were marked reachable" << std::endl;
+    std::size_t reachable = reached + dilated;
+
+    ReachabilityMap::save(argv[2], layout, capabilities);
+    std::cout << reachable << " of " << counts.size() << " bins are reachable, written to " << argv[2] << std::endl;
+    return 0;
+  }
+  catch (const std::exception& e)
+  {
+    std::cerr << e.what() << std::endl;
+    return -1;
+  }
+}
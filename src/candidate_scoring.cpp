@@ -0,0 +1,104 @@
+#include <algorithm>
+#include <numeric>
+#include <rl/math/Rotation.h>
+#include "candidate_scoring.h"
+
+namespace
+{
+/* Scale values to [0, 1], all of them to 0 if they are equal. */
+std::vector<rl::math::Real> normalize(std::vector<rl::math::Real> values)
+{
+  if (values.empty())
+    return values;
+
+  auto bounds = std::minmax_element(values.begin(), values.end());
+  auto minimum = *bounds.first;
+  auto range = *bounds.second - minimum;
+
+  for (auto& value : values)
+    value = range > 0 ? (value - minimum) / range : 0;
+
+  return values;
+}
+}  // namespace
+
+constexpr double CandidateScorer::rotation_weight;
+constexpr double CandidateScorer::maximum_clearance;
+
+CandidateScorer::CandidateScorer(std::shared_ptr<rl::kin::Kinematics> kinematics,
+                                 const rl::math::Vector& initial_configuration, const std::vector<Obstacle>& obstacles,
+                                 const Weights& weights)
+  : kinematics_(kinematics), initial_configuration_(initial_configuration), obstacles_(obstacles), weights_(weights)
+{
+  kinematics_->setPosition(initial_configuration_);
+  kinematics_->updateFrames();
+  kinematics_->updateJacobian();
+  kinematics_->updateJacobianInverse();
+
+  initial_pose_ = kinematics_->forwardPosition();
+  initial_jacobian_inverse_ = kinematics_->getJacobianInverse();
+}
+
+CandidateScorer::Features CandidateScorer::features(const rl::math::Transform& candidate)
+{
+  using namespace rl::math;
+
+  Features features;
+
+  Real rotation = AngleAxis(initial_pose_.linear().transpose() * candidate.linear()).angle();
+  features.distance = (candidate.translation() - initial_pose_.translation()).norm() + rotation_weight * rotation;
+
+  // a single step of the jacobian control, as long as the whole motion, estimates the goal configuration
+  Vector6 pose_delta;
+  transform::toDelta(initial_pose_, candidate, pose_delta);
+  Vector seed = initial_configuration_ + initial_jacobian_inverse_ * pose_delta;
+
+  if (kinematics_->isValid(seed))
+  {
+    kinematics_->setPosition(seed);
+    kinematics_->updateFrames();
+    kinematics_->updateJacobian();
+    features.manipulability = kinematics_->calculateManipulabilityMeasure();
+  }
+  else
+    features.manipulability = 0;
+
+  features.clearance = maximum_clearance;
+  for (auto& obstacle : obstacles_)
+  {
+    Vector3 local = obstacle.pose.inverse() * candidate.translation();
+    Real distance = (local.cwiseAbs() - obstacle.half_extents).cwiseMax(0).norm();
+    features.clearance = std::min(features.clearance, distance);
+  }
+
+  return features;
+}
+
+std::vector<std::size_t> CandidateScorer::order(const std::vector<rl::math::Transform>& candidates)
+{
+  std::vector<rl::math::Real> distances, manipulabilities, clearances;
+  for (auto& candidate : candidates)
+  {
+    auto candidate_features = features(candidate);
+    distances.push_back(candidate_features.distance);
+    manipulabilities.push_back(candidate_features.manipulability);
+    clearances.push_back(candidate_features.clearance);
+  }
+
+  distances = normalize(distances);
+  manipulabilities = normalize(manipulabilities);
+  clearances = normalize(clearances);
+
+  std::vector<rl::math::Real> scores;
+  for (std::size_t i = 0; i < candidates.size(); ++i)
+    scores.push_back(weights_.distance * (1 - distances[i]) + weights_.manipulability * manipulabilities[i] +
+                     weights_.clearance * clearances[i]);
+
+  // ties keep the order of generation, so equal weights of zero leave the candidates as they were sampled
+  std::vector<std::size_t> indices(candidates.size());
+  std::iota(indices.begin(), indices.end(), 0);
+  std::stable_sort(indices.begin(), indices.end(),
+                   [&scores](std::size_t a, std::size_t b) { return scores[a] > scores[b]; });
+
+  return indices;
+}
@@ -0,0 +1,65 @@
+#ifndef CANDIDATE_SCORING_H
+#define CANDIDATE_SCORING_H
+
+#include <memory>
+#include <vector>
+#include <rl/kin/Kinematics.h>
+#include <rl/math/Matrix.h>
+#include <rl/math/Transform.h>
+#include <rl/math/Vector.h>
+
+/* Orders sampled goal poses by how likely a rollout from an initial configuration reaches them, judged from quantities
+ * that cost no rollout: the distance of the pose from the initial end effector pose, the manipulability at a one step
+ * inverse kinematics estimate of the goal configuration, and the clearance of the pose from the bounding boxes the
+ * robot must not touch.
+ */
+class CandidateScorer
+{
+public:
+  /* A bounding box that must not be touched. */
+  struct Obstacle
+  {
+    rl::math::Transform pose;
+    rl::math::Vector3 half_extents;
+  };
+
+  /* The influence of every feature on the score. Every feature is scaled to [0, 1] within the candidates first. */
+  struct Weights
+  {
+    double distance = 1;
+    double manipulability = 1;
+    double clearance = 1;
+  };
+
+  struct Features
+  {
+    /* Metres of translation plus rotation_weight metres per radian of rotation from the initial end effector pose. */
+    rl::math::Real distance;
+    /* Zero if the estimated configuration violates the joint limits. */
+    rl::math::Real manipulability;
+    /* The distance of the position from the nearest obstacle, at most maximum_clearance. */
+    rl::math::Real clearance;
+  };
+
+  /* @param kinematics The kinematics of the robot, the frames are changed by the scorer. */
+  CandidateScorer(std::shared_ptr<rl::kin::Kinematics> kinematics, const rl::math::Vector& initial_configuration,
+                  const std::vector<Obstacle>& obstacles, const Weights& weights);
+
+  Features features(const rl::math::Transform& candidate);
+
+  /* The indices of candidates from the most to the least promising one. */
+  std::vector<std::size_t> order(const std::vector<rl::math::Transform>& candidates);
+
+  static constexpr double rotation_weight = 0.1;
+  static constexpr double maximum_clearance = 0.1;
+
+private:
+  std::shared_ptr<rl::kin::Kinematics> kinematics_;
+  rl::math::Vector initial_configuration_;
+  rl::math::Transform initial_pose_;
+  rl::math::Matrix initial_jacobian_inverse_;
+  std::vector<Obstacle> obstacles_;
+  Weights weights_;
+};
+
+#endif  // CANDIDATE_SCORING_H
@@ -0,0 +1,229 @@
+#include <algorithm>
+#include <cmath>
+#include <istream>
+#include <limits>
+#include <new>
+#include <ostream>
+#include <stdexcept>
+#include <boost/functional/hash.hpp>
+#include "cerrt_tree_snapshot.h"
+
+namespace
+{
+const char magic[8] = { 'C', 'E', 'R', 'R', 'T', 'R', 'E', 'E' };
+const std::uint32_t format_version = 1;
+
+template <class T> void write(std::ostream& stream, const T& value)
+{
+  stream.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <class T> T read(std::istream& stream)
+{
+  T value;
+  if (!stream.read(reinterpret_cast<char*>(&value), sizeof(T)))
+    throw std::runtime_error("The CERRT tree snapshot is truncated");
+
+  return value;
+}
+
+void writeString(std::ostream& stream, const std::string& string)
+{
+  write<std::uint64_t>(stream, string.size());
+  stream.write(string.data(), string.size());
+}
+
+/* The number of bytes from the read position of stream to its end, the largest value if the stream cannot seek. */
+std::uint64_t remainingBytes(std::istream& stream)
+{
+  auto position = stream.tellg();
+  if (position < 0 || !stream.seekg(0, std::ios::end))
+  {
+    stream.clear();
+    return std::numeric_limits<std::uint64_t>::max();
+  }
+
+  auto end = stream.tellg();
+  stream.seekg(position);
+  return static_cast<std::uint64_t>(end - position);
+}
+
+/* Read the number of elements of a sequence that takes at least element_bytes bytes per element, so that a corrupt
+ * count is noticed before the memory for it is allocated.
+ */
+std::uint64_t readCount(std::istream& stream, std::uint64_t element_bytes)
+{
+  auto count = read<std::uint64_t>(stream);
+  if (count > remainingBytes(stream) / element_bytes)
+    throw std::runtime_error("The CERRT tree snapshot is truncated or corrupt");
+
+  return count;
+}
+
+std::string readString(std::istream& stream)
+{
+  std::string string(readCount(stream, 1), '\0');
+  if (!stream.read(&string[0], string.size()))
+    throw std::runtime_error("The CERRT tree snapshot is truncated");
+
+  return string;
+}
+
+void writeReals(std::ostream& stream, const rl::math::Real* reals, std::size_t count)
+{
+  for (std::size_t i = 0; i < count; ++i)
+    write<double>(stream, reals[i]);
+}
+
+void readReals(std::istream& stream, rl::math::Real* reals, std::size_t count)
+{
+  for (std::size_t i = 0; i < count; ++i)
+    reals[i] = read<double>(stream);
+}
+
+std::int64_t quantize(rl::math::Real value, rl::math::Real resolution)
+{
+  return std::llround(value / resolution);
+}
+
+bool sameBox(const CerrtTreeSnapshot::Box& a, const CerrtTreeSnapshot::Box& b)
+{
+  return a.name == b.name && a.dimensions == b.dimensions && a.pose.isApprox(b.pose, 1.0e-6);
+}
+}
+
+void CerrtTreeSnapshot::save(std::ostream& stream) const
+{
+  stream.write(magic, sizeof(magic));
+  write(stream, format_version);
+  write(stream, scene_fingerprint);
+
+  write<std::uint64_t>(stream, boxes.size());
+  for (auto& box : boxes)
+  {
+    writeString(stream, box.name);
+    write<std::uint64_t>(stream, box.dimensions.size());
+    writeReals(stream, box.dimensions.data(), box.dimensions.size());
+    writeReals(stream, box.pose.matrix().data(), 16);
+  }
+
+  write<std::uint64_t>(stream, vertices.size());
+  for (auto& vertex : vertices)
+  {
+    write<std::uint64_t>(stream, vertex.parent);
+    write<std::uint64_t>(stream, vertex.particles.rows());
+    write<std::uint64_t>(stream, vertex.particles.cols());
+    writeReals(stream, vertex.particles.data(), vertex.particles.size());
+
+    for (auto& particle_contacts : vertex.contacts)
+    {
+      write<std::uint64_t>(stream, particle_contacts.size());
+      for (auto& contact : particle_contacts)
+      {
+        writeString(stream, contact.first);
+        writeString(stream, contact.second);
+      }
+    }
+  }
+
+  if (!stream)
+    throw std::runtime_error("Could not write the CERRT tree snapshot");
+}
+
+CerrtTreeSnapshot CerrtTreeSnapshot::load(std::istream& stream)
+{
+  char file_magic[sizeof(magic)];
+  if (!stream.read(file_magic, sizeof(file_magic)) || !std::equal(magic, magic + sizeof(magic), file_magic))
+    throw std::runtime_error("The stream does not contain a CERRT tree snapshot");
+  if (read<std::uint32_t>(stream) != format_version)
+    throw std::runtime_error("The CERRT tree snapshot has an unsupported format version");
+
+  // the smallest number of bytes save writes for a box, a vertex, the contacts of a particle and a contact
+  const std::uint64_t box_bytes = 8 + 8 + 16 * 8;
+  const std::uint64_t vertex_bytes = 3 * 8;
+  const std::uint64_t particle_contacts_bytes = 8;
+  const std::uint64_t contact_bytes = 2 * 8;
+
+  CerrtTreeSnapshot snapshot;
+  try
+  {
+    snapshot.scene_fingerprint = read<std::uint64_t>(stream);
+
+    snapshot.boxes.resize(readCount(stream, box_bytes));
+    for (auto& box : snapshot.boxes)
+    {
+      box.name = readString(stream);
+      box.dimensions.resize(readCount(stream, sizeof(double)));
+      readReals(stream, box.dimensions.data(), box.dimensions.size());
+      readReals(stream, box.pose.matrix().data(), 16);
+    }
+
+    snapshot.vertices.resize(readCount(stream, vertex_bytes));
+    for (std::size_t i = 0; i < snapshot.vertices.size(); ++i)
+    {
+      auto& vertex = snapshot.vertices[i];
+      vertex.parent = read<std::uint64_t>(stream);
+      if ((i == 0) != (vertex.parent == Vertex::no_parent) || (i > 0 && vertex.parent >= i))
+        throw std::runtime_error("The vertices of the CERRT tree snapshot are not ordered from the root");
+
+      // every particle is followed by its reals and the number of its contacts
+      auto rows = readCount(stream, sizeof(double));
+      auto cols = readCount(stream, particle_contacts_bytes + rows * sizeof(double));
+      vertex.particles.resize(rows, cols);
+      readReals(stream, vertex.particles.data(), vertex.particles.size());
+
+      vertex.contacts.resize(cols);
+      for (auto& particle_contacts : vertex.contacts)
+      {
+        particle_contacts.resize(readCount(stream, contact_bytes));
+        for (auto& contact : particle_contacts)
+        {
+          contact.first = readString(stream);
+          contact.second = readString(stream);
+        }
+      }
+    }
+  }
+  catch (const std::bad_alloc&)
+  {
+    throw std::runtime_error("The CERRT tree snapshot is too large to load");
+  }
+  catch (const std::length_error&)
+  {
+    throw std::runtime_error("The CERRT tree snapshot is too large to load");
+  }
+
+  return snapshot;
+}
+
+std::uint64_t sceneFingerprint(const rl::math::Transform& ifco_pose, std::size_t dof)
+{
+  std::size_t seed = 0;
+  boost::hash_combine(seed, dof);
+  for (int i = 0; i < 3; ++i)
+    boost::hash_combine(seed, quantize(ifco_pose.translation()(i), 1.0e-3));
+  for (int i = 0; i < 3; ++i)
+    for (int j = 0; j < 3; ++j)
+      boost::hash_combine(seed, quantize(ifco_pose.linear()(i, j), 1.0e-3));
+
+  return seed;
+}
+
+std::vector<CerrtTreeSnapshot::Box> changedBoxes(const std::vector<CerrtTreeSnapshot::Box>& before,
+                                                 const std::vector<CerrtTreeSnapshot::Box>& after)
+{
+  std::vector<CerrtTreeSnapshot::Box> changed;
+  auto contains = [](const std::vector<CerrtTreeSnapshot::Box>& boxes, const CerrtTreeSnapshot::Box& box) {
+    return std::any_of(boxes.begin(), boxes.end(),
+                       [&box](const CerrtTreeSnapshot::Box& other) { return sameBox(box, other); });
+  };
+
+  for (auto& box : before)
+    if (!contains(after, box))
+      changed.push_back(box);
+  for (auto& box : after)
+    if (!contains(before, box))
+      changed.push_back(box);
+
+  return changed;
+}
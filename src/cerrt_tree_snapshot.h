@@ -0,0 +1,69 @@
+#ifndef CERRT_TREE_SNAPSHOT_H
+#define CERRT_TREE_SNAPSHOT_H
+
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+#include <utility>
+#include <vector>
+#include <rl/math/Matrix.h>
+#include <rl/math/Transform.h>
+#include <rl/math/Vector.h>
+
+/* The explored tree of a SomaCerrt solve, detached from the planner so that a later query in the same IFCO can
+ * continue from it. Every vertex keeps the particles of its belief state together with the contacts each particle
+ * had at the end of the edge leading to it.
+ */
+struct CerrtTreeSnapshot
+{
+  /* A bounding box of the scene the tree was planned in. */
+  struct Box
+  {
+    std::string name;
+    std::vector<double> dimensions;
+    rl::math::Transform pose;
+  };
+
+  struct Vertex
+  {
+    // index of the parent vertex, the root has none
+    static constexpr std::size_t no_parent = static_cast<std::size_t>(-1);
+    std::size_t parent = no_parent;
+
+    // column i is the configuration of particle i
+    rl::math::Matrix particles;
+
+    // the (robot part, world part) contacts of every particle
+    std::vector<std::vector<std::pair<std::string, std::string>>> contacts;
+
+    rl::math::Vector mean() const
+    {
+      return particles.rowwise().mean();
+    }
+  };
+
+  std::uint64_t scene_fingerprint = 0;
+  std::vector<Box> boxes;
+
+  // parents come before their children, the root is the first vertex
+  std::vector<Vertex> vertices;
+
+  /* Write the snapshot in a binary format. Throws std::runtime_error if the stream fails. */
+  void save(std::ostream& stream) const;
+
+  /* Read a snapshot written by save. Throws std::runtime_error if the stream is not a snapshot, is truncated or holds
+   * sizes that do not fit into the rest of the stream.
+   */
+  static CerrtTreeSnapshot load(std::istream& stream);
+};
+
+/* A key for trees that can be reused: the robot and the IFCO pose, quantized to a millimetre and a milliradian. The
+ * bounding boxes are not part of it, they are compared with changedBoxes when the tree is reused.
+ */
+std::uint64_t sceneFingerprint(const rl::math::Transform& ifco_pose, std::size_t dof);
+
+/* The boxes of before that were moved, resized or removed, and the boxes of after that are new. */
+std::vector<CerrtTreeSnapshot::Box> changedBoxes(const std::vector<CerrtTreeSnapshot::Box>& before,
+                                                 const std::vector<CerrtTreeSnapshot::Box>& after);
+
+#endif  // CERRT_TREE_SNAPSHOT_H
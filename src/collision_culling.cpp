@@ -0,0 +1,96 @@
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <stdexcept>
+#include "collision_culling.h"
+
+namespace
+{
+/* The installed cullings, the user index of a marked collision object is its slot. Bullet passes no user data to a
+ * near callback, so the callback finds the culling of a pair through its objects.
+ */
+std::array<std::atomic<CollisionCulling*>, CollisionCulling::maximum_scenes> installed_cullings{};
+}  // namespace
+
+CollisionCulling::Test::~Test()
+{
+}
+
+CollisionCulling::CollisionCulling(std::shared_ptr<rl::sg::bullet::Scene> scene) : scene_(scene), slot_(-1)
+{
+  for (std::size_t i = 0; i < installed_cullings.size() && slot_ < 0; ++i)
+  {
+    CollisionCulling* free = nullptr;
+    if (installed_cullings[i].compare_exchange_strong(free, this))
+      slot_ = static_cast<int>(i);
+  }
+
+  if (slot_ < 0)
+    throw std::runtime_error("Too many collision cullings are installed at the same time");
+
+  auto& objects = scene_->world->getCollisionObjectArray();
+  for (int i = 0; i < objects.size(); ++i)
+    objects[i]->setUserIndex(slot_);
+
+  scene_->dispatcher->setNearCallback(&CollisionCulling::nearCallback);
+}
+
+CollisionCulling::~CollisionCulling()
+{
+  scene_->dispatcher->setNearCallback(&btCollisionDispatcher::defaultNearCallback);
+
+  auto& objects = scene_->world->getCollisionObjectArray();
+  for (int i = 0; i < objects.size(); ++i)
+    objects[i]->setUserIndex(-1);
+
+  installed_cullings[slot_].store(nullptr);
+}
+
+void CollisionCulling::addTest(std::shared_ptr<Test> test)
+{
+  tests_.push_back(test);
+  culled_by_test_.push_back(0);
+}
+
+void CollisionCulling::nearCallback(btBroadphasePair& pair, btCollisionDispatcher& dispatcher,
+                                    const btDispatcherInfo& info)
+{
+  auto a = static_cast<const btCollisionObject*>(pair.m_pProxy0->m_clientObject);
+  auto b = static_cast<const btCollisionObject*>(pair.m_pProxy1->m_clientObject);
+
+  int slot = std::max(a->getUserIndex(), b->getUserIndex());
+  auto culling = slot >= 0 && slot < static_cast<int>(maximum_scenes) ? installed_cullings[slot].load() : nullptr;
+
+  if (!culling)
+  {
+    btCollisionDispatcher::defaultNearCallback(pair, dispatcher, info);
+    return;
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  ++culling->tested_pairs_;
+  for (std::size_t t = 0; t < culling->tests_.size(); ++t)
+  {
+    if (!culling->tests_[t]->separated(*a, *b))
+      continue;
+
+    // the contacts of an earlier step would otherwise stay in the manifold of the pair
+    if (pair.m_algorithm)
+    {
+      btManifoldArray manifolds;
+      pair.m_algorithm->getAllContactManifolds(manifolds);
+      for (int i = 0; i < manifolds.size(); ++i)
+        manifolds[i]->clearManifold();
+    }
+
+    ++culling->culled_pairs_;
+    ++culling->culled_by_test_[t];
+    culling->test_time_ += std::chrono::steady_clock::now() - start;
+    return;
+  }
+
+  auto tested = std::chrono::steady_clock::now();
+  culling->test_time_ += tested - start;
+  btCollisionDispatcher::defaultNearCallback(pair, dispatcher, info);
+  culling->narrow_phase_time_ += std::chrono::steady_clock::now() - tested;
+}
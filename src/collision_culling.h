@@ -0,0 +1,93 @@
+#ifndef COLLISION_CULLING_H
+#define COLLISION_CULLING_H
+
+#include <chrono>
+#include <memory>
+#include <vector>
+#include <btBulletCollisionCommon.h>
+#include <rl/sg/bullet/Scene.h>
+
+/* Cheap tests of the pairs of a bullet scene that run before the narrow phase of bullet. If a test proves that the
+ * shapes of a pair are apart, bullet does not compute their contacts, otherwise it computes them as usual. The
+ * collision map of the scene stays the same, it only becomes cheaper to compute.
+ */
+class CollisionCulling
+{
+public:
+  class Test
+  {
+  public:
+    virtual ~Test();
+
+    /* Whether the shapes of a and b are certainly farther apart than the contact threshold of bullet. */
+    virtual bool separated(const btCollisionObject& a, const btCollisionObject& b) = 0;
+  };
+
+  /* Install the culling as the near callback of the dispatcher of scene. The collision objects the scene has now are
+   * marked as belonging to it. A pair of objects that are both unmarked, e.g. two bounding boxes created later, is
+   * not tested. At most maximum_scenes cullings can be installed at the same time, std::runtime_error is thrown
+   * otherwise.
+   */
+  explicit CollisionCulling(std::shared_ptr<rl::sg::bullet::Scene> scene);
+
+  /* Restores the default near callback. */
+  ~CollisionCulling();
+
+  CollisionCulling(const CollisionCulling&) = delete;
+  CollisionCulling& operator=(const CollisionCulling&) = delete;
+
+  /* Tests run in the order they were added, the first one that proves a pair apart ends the testing. */
+  void addTest(std::shared_ptr<Test> test);
+
+  /* The number of pairs that were tested, and the number of them that the tests proved apart, all of them or the ones
+   * the test with the given index proved apart first.
+   */
+  std::size_t testedPairs() const
+  {
+    return tested_pairs_;
+  }
+
+  std::size_t culledPairs() const
+  {
+    return culled_pairs_;
+  }
+
+  std::size_t culledPairs(std::size_t test) const
+  {
+    return culled_by_test_[test];
+  }
+
+  std::size_t numTests() const
+  {
+    return tests_.size();
+  }
+
+  /* The time spent in the tests, and in the narrow phase of bullet for the pairs the tests did not prove apart. */
+  double testSeconds() const
+  {
+    return test_time_.count();
+  }
+
+  double narrowPhaseSeconds() const
+  {
+    return narrow_phase_time_.count();
+  }
+
+  static const std::size_t maximum_scenes = 256;
+
+private:
+  static void nearCallback(btBroadphasePair& pair, btCollisionDispatcher& dispatcher, const btDispatcherInfo& info);
+
+  std::shared_ptr<rl::sg::bullet::Scene> scene_;
+  int slot_;
+  std::vector<std::shared_ptr<Test>> tests_;
+
+  // only the thread that queries the scene updates them
+  std::size_t tested_pairs_ = 0;
+  std::size_t culled_pairs_ = 0;
+  std::vector<std::size_t> culled_by_test_;
+  std::chrono::duration<double> test_time_{ 0 };
+  std::chrono::duration<double> narrow_phase_time_{ 0 };
+};
+
+#endif  // COLLISION_CULLING_H
@@ -48,6 +48,11 @@ void WorldCollisionTypes::WorldRequiredCollisionsCounter::countCollision(const s
   nonpresent_required_world_collisions_.erase(world_part);
 }
 
+std::shared_ptr<RequiredCollisionsCounter> WorldCollisionTypes::WorldRequiredCollisionsCounter::clone() const
+{
+  return std::make_shared<WorldRequiredCollisionsCounter>(nonpresent_required_world_collisions_);
+}
+
 CollisionType IgnoreAllCollisionTypes::getCollisionType(const std::string&, const std::string&) const
 {
   CollisionType t;
@@ -73,6 +78,11 @@ void IgnoreAllCollisionTypes::IgnoreAllRequiredCollisionsCounter::countCollision
 {
 }
 
+std::shared_ptr<RequiredCollisionsCounter> IgnoreAllCollisionTypes::IgnoreAllRequiredCollisionsCounter::clone() const
+{
+  return std::make_shared<IgnoreAllRequiredCollisionsCounter>();
+}
+
 RequiredCollisionsCounter::~RequiredCollisionsCounter()
 {
 }
@@ -31,6 +31,8 @@ public:
   virtual bool allRequiredPresent() const = 0;
   /* Count the collision between robot_part and world_part. */
   virtual void countCollision(const std::string& robot_part, const std::string& world_part) = 0;
+  /* An independent counter that has seen the same collisions as this one. */
+  virtual std::shared_ptr<RequiredCollisionsCounter> clone() const = 0;
 };
 
 /* An interface for specifying collision constraints and requirements. */
@@ -66,6 +68,7 @@ private:
 
     bool allRequiredPresent() const override;
     void countCollision(const std::string& robot_part, const std::string& world_part) override;
+    std::shared_ptr<RequiredCollisionsCounter> clone() const override;
 
   private:
     std::unordered_set<std::string> nonpresent_required_world_collisions_;
@@ -92,6 +95,7 @@ private:
   public:
     bool allRequiredPresent() const override;
     void countCollision(const std::string& robot_part, const std::string& world_part) override;
+    std::shared_ptr<RequiredCollisionsCounter> clone() const override;
   };
 };
 
@@ -109,6 +113,7 @@ private:
     ~IgnoreAllRequiredCollisionsCounter() override;
     bool allRequiredPresent() const override;
     void countCollision(const std::string& robot_part, const std::string& world_part) override;
+    std::shared_ptr<RequiredCollisionsCounter> clone() const override;
   };
 };
 
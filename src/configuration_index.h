@@ -0,0 +1,118 @@
+#ifndef CONFIGURATION_INDEX_H
+#define CONFIGURATION_INDEX_H
+
+#include <cmath>
+#include <limits>
+#include <utility>
+#include <vector>
+#include <rl/math/Vector.h>
+
+/* A kd-tree over configurations for nearest neighbour queries with the euclidean joint space distance, the
+ * distance used by rl::plan::SimpleModel. It is built incrementally: configurations are inserted one by one, the
+ * splitting dimension cycles with the depth. Every configuration carries a value, for example the vertex of a tree.
+ * The configurations are stored contiguously, inserting does not allocate per configuration.
+ */
+template <class Value> class ConfigurationIndex
+{
+public:
+  void insert(const rl::math::Vector& configuration, const Value& value)
+  {
+    dof_ = configuration.size();
+    configurations_.insert(configurations_.end(), configuration.data(), configuration.data() + dof_);
+    nodes_.push_back({ value, 0, -1, -1 });
+    int inserted = static_cast<int>(nodes_.size()) - 1;
+    if (inserted == 0)
+      return;
+
+    int node = 0;
+    while (true)
+    {
+      auto& current = nodes_[node];
+      auto& child =
+          configuration(current.split) < coordinate(node, current.split) ? current.left : current.right;
+      if (child < 0)
+      {
+        child = inserted;
+        nodes_[inserted].split = (current.split + 1) % dof_;
+        return;
+      }
+
+      node = child;
+    }
+  }
+
+  /* The value of the nearest configuration and the distance to it. The index must not be empty. */
+  std::pair<Value, rl::math::Real> nearest(const rl::math::Vector& configuration) const
+  {
+    int best = -1;
+    auto best_squared_distance = std::numeric_limits<rl::math::Real>::infinity();
+    nearest(0, configuration, best, best_squared_distance);
+
+    return { nodes_[best].value, std::sqrt(best_squared_distance) };
+  }
+
+  /* The value inserted i-th. */
+  const Value& operator[](std::size_t i) const
+  {
+    return nodes_[i].value;
+  }
+
+  std::size_t size() const
+  {
+    return nodes_.size();
+  }
+
+  bool empty() const
+  {
+    return nodes_.empty();
+  }
+
+  void clear()
+  {
+    nodes_.clear();
+    configurations_.clear();
+  }
+
+private:
+  struct Node
+  {
+    Value value;
+    int split;
+    int left;
+    int right;
+  };
+
+  void nearest(int node, const rl::math::Vector& configuration, int& best, rl::math::Real& best_squared_distance) const
+  {
+    if (node < 0)
+      return;
+
+    auto& current = nodes_[node];
+    Eigen::Map<const rl::math::Vector> node_configuration(&configurations_[node * dof_], dof_);
+    auto squared_distance = (configuration - node_configuration).squaredNorm();
+    if (squared_distance < best_squared_distance)
+    {
+      best = node;
+      best_squared_distance = squared_distance;
+    }
+
+    // descend into the side of the query first, the other side only if the splitting plane is closer than the best
+    auto difference = configuration(current.split) - coordinate(node, current.split);
+    nearest(difference < 0 ? current.left : current.right, configuration, best, best_squared_distance);
+    if (difference * difference < best_squared_distance)
+      nearest(difference < 0 ? current.right : current.left, configuration, best, best_squared_distance);
+  }
+
+  rl::math::Real coordinate(int node, int dimension) const
+  {
+    return configurations_[node * dof_ + dimension];
+  }
+
+  // nodes are stored in insertion order, children are referenced by their position
+  std::vector<Node> nodes_;
+  // the configuration of the i-th node starts at i * dof_
+  std::vector<rl::math::Real> configurations_;
+  int dof_ = 0;
+};
+
+#endif  // CONFIGURATION_INDEX_H
@@ -1,6 +1,11 @@
 #include <Inventor/nodes/SoPerspectiveCamera.h>
 #include <Inventor/VRMLnodes/SoVRMLBox.h>
+#include <rl/sg/Body.h>
+#include <rl/sg/Shape.h>
 #include "utilities.h"
+#include "ifco_slabs.h"
+#include "sphere_tree.h"
+#include "self_collision_mask.h"
 #include "ifco_scene.h"
 
 IfcoScene::~IfcoScene()
@@ -8,6 +13,13 @@ IfcoScene::~IfcoScene()
 }
 
 std::unique_ptr<IfcoScene> IfcoScene::load(const std::string& scene_graph_file, const std::string& kinematics_file)
+{
+  return load(scene_graph_file, kinematics_file, nullptr, nullptr);
+}
+
+std::unique_ptr<IfcoScene> IfcoScene::load(const std::string& scene_graph_file, const std::string& kinematics_file,
+                                           std::shared_ptr<const SelfCollisionMask> self_collision_mask,
+                                           std::shared_ptr<const SphereTreeSet> sphere_trees)
 {
   using rl::kin::Kinematics;
   using namespace rl::sg;
@@ -20,19 +32,87 @@ std::unique_ptr<IfcoScene> IfcoScene::load(const std::string& scene_graph_file,
   ifco_scene->bullet_scene.reset(new rl::sg::bullet::Scene);
   ifco_scene->bullet_scene->load(scene_graph_file);
 
+  // the mask is built once, the clones share it
+  if (!self_collision_mask)
+    self_collision_mask = SelfCollisionMask::build(*ifco_scene->kinematics, *ifco_scene->bullet_scene);
+  ifco_scene->self_collision_mask = self_collision_mask;
+  ifco_scene->self_collision_filter.reset(new SelfCollisionFilter(ifco_scene->bullet_scene, self_collision_mask));
+
+  ifco_scene->collision_culling.reset(new CollisionCulling(ifco_scene->bullet_scene));
   for (std::size_t i = 0; i < ifco_scene->bullet_scene->getNumModels(); ++i)
   {
     auto model = ifco_scene->bullet_scene->getModel(i);
     if (model->getName() == "ifco")
     {
       ifco_scene->ifco_model_index = i;
+      ifco_scene->collision_culling->addTest(std::make_shared<IfcoSlabTest>(*ifco_scene->bullet_scene, *model));
       break;
     }
   }
 
+  // after the exact test of the walls, it decides the pairs of the walls that the sphere trees would only bound. The
+  // trees are built once, before any bounding box is created, the clones share them
+  if (!sphere_trees)
+    sphere_trees = SphereTreeSet::build(*ifco_scene->bullet_scene);
+  ifco_scene->sphere_trees = sphere_trees;
+  ifco_scene->collision_culling->addTest(std::make_shared<SphereTreeTest>(*ifco_scene->bullet_scene, sphere_trees));
+
   return ifco_scene;
 }
 
+std::unique_ptr<IfcoScene> IfcoScene::clone() const
+{
+  auto copy = load(scene_graph_file, kinematics_file, self_collision_mask, sphere_trees);
+  copy->moveIfco(current_ifco_pose);
+  for (auto& box : created_boxes)
+    copy->createBox(box.dimensions, box.pose, box.name);
+
+  return copy;
+}
+
+void IfcoScene::synchronize(const IfcoScene& scene)
+{
+  moveIfco(scene.current_ifco_pose);
+  removeBoxes();
+  for (auto& box : scene.created_boxes)
+    createBox(box.dimensions, box.pose, box.name);
+}
+
+std::vector<ApproachRoadmap::Part> IfcoScene::getIfcoParts() const
+{
+  std::vector<ApproachRoadmap::Part> parts;
+  if (ifco_model_index >= bullet_scene->getNumModels())
+    return parts;
+
+  // the bullet shapes of rl keep their rl::sg::Shape as the user pointer of their collision objects
+  std::unordered_map<const rl::sg::Shape*, const btCollisionObject*> shape_objects;
+  auto& objects = bullet_scene->world->getCollisionObjectArray();
+  for (int i = 0; i < objects.size(); ++i)
+    shape_objects[static_cast<const rl::sg::Shape*>(objects[i]->getUserPointer())] = objects[i];
+
+  // the bounding boxes are bodies of their own, the first body is the IFCO
+  auto body = bullet_scene->getModel(ifco_model_index)->getBody(0);
+  for (std::size_t i = 0; i < body->getNumShapes(); ++i)
+  {
+    auto shape = body->getShape(i);
+    auto object = shape_objects.find(shape);
+    if (object == shape_objects.end() ||
+        object->second->getCollisionShape()->getShapeType() != BOX_SHAPE_PROXYTYPE)
+      continue;
+
+    auto box = static_cast<const btBoxShape*>(object->second->getCollisionShape());
+    btVector3 half_extents = box->getHalfExtentsWithMargin();
+
+    ApproachRoadmap::Part part;
+    part.name = shape->getName();
+    shape->getTransform(part.pose);
+    part.dimensions = 2 * rl::math::Vector3(half_extents.x(), half_extents.y(), half_extents.z());
+    parts.push_back(part);
+  }
+
+  return parts;
+}
+
 void IfcoScene::connectToViewer(Viewer* viewer)
 {
   viewer->kinematics.reset(rl::kin::Kinematics::create(kinematics_file));
@@ -67,6 +147,8 @@ void IfcoScene::moveIfco(const rl::math::Transform& ifco_pose)
 
   findAndMoveIfco(*bullet_scene);
   emit applyFunctionToScene(findAndMoveIfco);
+
+  current_ifco_pose = ifco_pose;
 }
 
 void IfcoScene::createBox(const std::vector<double> dimensions, const rl::math::Transform& box_pose,
@@ -98,6 +180,8 @@ void IfcoScene::createBox(const std::vector<double> dimensions, const rl::math::
   createBoxInScene(*bullet_scene);
   emit applyFunctionToScene(createBoxInScene);
 
+  created_boxes.push_back({ dimensions, box_pose, name });
+
   if (++current_color == colors.end())
     current_color = colors.begin();
 }
@@ -117,5 +201,6 @@ void IfcoScene::removeBoxes()
   removeBoxesInScene(*bullet_scene);
   emit applyFunctionToScene(removeBoxesInScene);
 
+  created_boxes.clear();
   current_color = colors.begin();
 }
@@ -7,6 +7,7 @@
 #include <rl/plan/DistanceModel.h>
 #include <rl/sg/bullet/Scene.h>
 #include <rl/sg/so/Scene.h>
+#include <limits>
 #include <string>
 #include <memory>
 #include <unordered_map>
@@ -14,6 +15,10 @@
 #include <QMetaType>
 
 #include "Viewer.h"
+#include "approach_roadmap.h"
+#include "collision_culling.h"
+#include "self_collision_mask.h"
+#include "sphere_tree.h"
 #include "utilities.h"
 
 class IfcoScene : public QObject
@@ -23,6 +28,16 @@ public:
   ~IfcoScene();
   static std::unique_ptr<IfcoScene> load(const std::string& scene_graph_file, const std::string& kinematics_file);
 
+  /* Load an independent copy of this scene from the same files, with the same IFCO pose and bounding boxes. The copy
+   * is not connected to a viewer, so it can be used by another thread.
+   */
+  std::unique_ptr<IfcoScene> clone() const;
+
+  /* Move the IFCO and replace the bounding boxes like in scene, which must have been loaded from the same files. Much
+   * cheaper than a new clone, so copies can be kept and brought up to date for every request.
+   */
+  void synchronize(const IfcoScene& scene);
+
   void connectToViewer(Viewer* new_viewer);
 
   void moveIfco(const rl::math::Transform& ifco_pose);
@@ -33,12 +48,27 @@ public:
   std::shared_ptr<rl::sg::bullet::Scene> getBulletScene() { return bullet_scene; }
   boost::optional<Viewer*> getViewer() { return viewer_; }
 
+  /* The tests that spare bullet the narrow phase of pairs that are apart: the IFCO walls, if the scene has an IFCO,
+   * and the sphere trees of the link hulls.
+   */
+  CollisionCulling* getCollisionCulling() { return collision_culling.get(); }
+
+  /* The box shapes of the IFCO model itself, without the bounding boxes, in the frame of the model. Empty if the
+   * scene has no IFCO.
+   */
+  std::vector<ApproachRoadmap::Part> getIfcoParts() const;
+
   std::size_t dof() const
   {
     return kinematics->getDof();
   }
 
 private:
+  /* Load the scene with the given self-collision mask and sphere trees, or with new ones if they are null. */
+  static std::unique_ptr<IfcoScene> load(const std::string& scene_graph_file, const std::string& kinematics_file,
+                                         std::shared_ptr<const SelfCollisionMask> self_collision_mask,
+                                         std::shared_ptr<const SphereTreeSet> sphere_trees);
+
   IfcoScene() : QObject(nullptr)
   {
     qRegisterMetaType<rl::math::Vector>("rl::math::Vector");
@@ -56,7 +86,24 @@ private:
   std::shared_ptr<rl::kin::Kinematics> kinematics;
   std::shared_ptr<rl::sg::bullet::Scene> bullet_scene;
 
-  std::size_t ifco_model_index;
+  std::size_t ifco_model_index = std::numeric_limits<std::size_t>::max();
+
+  std::shared_ptr<const SelfCollisionMask> self_collision_mask;
+  std::shared_ptr<const SphereTreeSet> sphere_trees;
+
+  // destroyed before bullet_scene, they restore the callbacks of its dispatcher and its pair cache
+  std::unique_ptr<SelfCollisionFilter> self_collision_filter;
+  std::unique_ptr<CollisionCulling> collision_culling;
+
+  /* The state set by moveIfco and createBox, replayed by clone. */
+  struct BoxDescription
+  {
+    std::vector<double> dimensions;
+    rl::math::Transform pose;
+    std::string name;
+  };
+  rl::math::Transform current_ifco_pose = rl::math::Transform::Identity();
+  std::vector<BoxDescription> created_boxes;
 
   boost::optional<Viewer*> viewer_;
 
@@ -0,0 +1,67 @@
+#include <algorithm>
+#include <unordered_set>
+#include <rl/sg/Body.h>
+#include <rl/sg/Shape.h>
+#include "ifco_slabs.h"
+
+IfcoSlabTest::IfcoSlabTest(rl::sg::bullet::Scene& scene, rl::sg::Model& ifco_model)
+{
+  auto body = ifco_model.getBody(0);
+  std::unordered_set<const rl::sg::Shape*> shapes;
+  for (std::size_t i = 0; i < body->getNumShapes(); ++i)
+    shapes.insert(body->getShape(i));
+
+  // the bullet shapes of rl keep their rl::sg::Shape as the user pointer of their collision objects
+  auto& objects = scene.world->getCollisionObjectArray();
+  for (int i = 0; i < objects.size(); ++i)
+  {
+    auto shape = static_cast<const rl::sg::Shape*>(objects[i]->getUserPointer());
+    if (shapes.count(shape) && objects[i]->getCollisionShape()->getShapeType() == BOX_SHAPE_PROXYTYPE)
+      slabs_.insert({ objects[i], const_cast<rl::sg::Shape*>(shape)->getName() });
+  }
+}
+
+IfcoSlabTest::~IfcoSlabTest()
+{
+}
+
+bool IfcoSlabTest::separated(const btCollisionObject& a, const btCollisionObject& b)
+{
+  bool a_is_slab = slabs_.count(&a);
+  bool b_is_slab = slabs_.count(&b);
+  if (a_is_slab == b_is_slab)
+    return false;
+
+  auto& slab = a_is_slab ? a : b;
+  auto& other = a_is_slab ? b : a;
+  if (!other.getCollisionShape()->isConvex())
+    return false;
+
+  // bullet keeps contacts up to the breaking threshold apart
+  return faceDistance(other, slab) > gContactBreakingThreshold;
+}
+
+btScalar IfcoSlabTest::faceDistance(const btCollisionObject& convex_object, const btCollisionObject& slab_object)
+{
+  auto convex = static_cast<const btConvexShape*>(convex_object.getCollisionShape());
+  auto box = static_cast<const btBoxShape*>(slab_object.getCollisionShape());
+  auto& convex_transform = convex_object.getWorldTransform();
+  auto& slab_transform = slab_object.getWorldTransform();
+  btVector3 half_extents = box->getHalfExtentsWithMargin();
+
+  btScalar distance = -BT_LARGE_FLOAT;
+  for (int axis = 0; axis < 3; ++axis)
+  {
+    btVector3 normal = slab_transform.getBasis().getColumn(axis);
+    for (btScalar side : { btScalar(1), btScalar(-1) })
+    {
+      btVector3 outwards = side * normal;
+      // the point of the convex shape that reaches furthest towards the slab, including the margin
+      btVector3 local_direction = -outwards * convex_transform.getBasis();
+      btVector3 support = convex_transform(convex->localGetSupportingVertex(local_direction));
+      distance = std::max(distance, outwards.dot(support - slab_transform.getOrigin()) - half_extents[axis]);
+    }
+  }
+
+  return distance;
+}
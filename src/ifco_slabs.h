@@ -0,0 +1,45 @@
+#ifndef IFCO_SLABS_H
+#define IFCO_SLABS_H
+
+#include <string>
+#include <unordered_map>
+#include <rl/sg/Model.h>
+#include <rl/sg/bullet/Scene.h>
+#include "collision_culling.h"
+
+/* The walls and the bottom of the IFCO ("north", "south", "east", "west" and "bottom" in model/rlsg/ifco.wrl) as
+ * oriented slabs, boxes bounded by three pairs of parallel planes. A convex shape, like the hull of a link, is apart
+ * from a slab if its support point towards the slab lies beyond one of the six face planes. The support functions
+ * give the exact distance of the shape from every face plane, so the test costs six support queries instead of the
+ * iterations of the general convex-convex algorithm of bullet, and it decides most pairs since the walls are thin.
+ *
+ * The test only separates, it computes neither contacts nor distances. A shape within the contact threshold of all
+ * face planes can still be apart from the slab near its edges and corners, telling these apart needs the
+ * convex-convex algorithm anyway. Such pairs, the ones in contact among them, go to bullet, so the collision map and
+ * the constraint names of the contacts are the ones bullet computes.
+ */
+class IfcoSlabTest : public CollisionCulling::Test
+{
+public:
+  /* @param ifco_model The model of the IFCO in scene, its first body holds the walls and the bottom. */
+  IfcoSlabTest(rl::sg::bullet::Scene& scene, rl::sg::Model& ifco_model);
+  ~IfcoSlabTest() override;
+
+  bool separated(const btCollisionObject& a, const btCollisionObject& b) override;
+
+  /* The largest distance of a convex shape from the face planes of a slab, measured outwards. Positive if and only if
+   * a face plane separates the two, then it is a lower bound of their distance.
+   */
+  static btScalar faceDistance(const btCollisionObject& convex, const btCollisionObject& slab);
+
+  /* The collision objects of the slabs, by the names of their shapes. */
+  const std::unordered_map<const btCollisionObject*, std::string>& slabs() const
+  {
+    return slabs_;
+  }
+
+private:
+  std::unordered_map<const btCollisionObject*, std::string> slabs_;
+};
+
+#endif  // IFCO_SLABS_H
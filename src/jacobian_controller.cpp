@@ -1,7 +1,95 @@
 #include <rl/plan/Particle.h>
+#include <rl/sg/Body.h>
+#include <rl/sg/Shape.h>
+#include <btBulletCollisionCommon.h>
 #include "jacobian_controller.h"
+#include "self_collision_mask.h"
+#include <algorithm>
+#include <cmath>
 #include <iostream>
 #include <fstream>
+#include <limits>
+#include <unordered_set>
+
+namespace
+{
+// below this manipulability measure a configuration is considered singular
+const rl::math::Real singularity_threshold = 1.0e-3;
+// metres of end effector translation that count as much as a radian of rotation
+const rl::math::Real rotation_distance_weight = 0.1;
+
+/* Grows the shapes of the robot by a margin for as long as it exists, so that a collision query reports everything
+ * closer than the margin to the robot, or closer than twice the margin between two links. Hulls get a larger
+ * collision margin, boxes, cylinders and spheres larger dimensions, since their margin does not change their size.
+ * If the robot has a shape of another type nothing is grown and the object converts to false.
+ */
+class InflatedRobot
+{
+public:
+  InflatedRobot(const std::vector<btCollisionObject*>& robot_objects, btScalar margin)
+  {
+    for (auto object : robot_objects)
+    {
+      auto shape = object->getCollisionShape();
+      switch (shape->getShapeType())
+      {
+        case CONVEX_HULL_SHAPE_PROXYTYPE:
+        case BOX_SHAPE_PROXYTYPE:
+        case CYLINDER_SHAPE_PROXYTYPE:
+        case SPHERE_SHAPE_PROXYTYPE:
+          break;
+        default:
+          return;
+      }
+    }
+
+    for (auto object : robot_objects)
+    {
+      auto shape = static_cast<btConvexInternalShape*>(object->getCollisionShape());
+      grown_.push_back({ shape, shape->getMargin(), shape->getImplicitShapeDimensions() });
+      if (shape->getShapeType() == CONVEX_HULL_SHAPE_PROXYTYPE)
+      {
+        shape->setMargin(shape->getMargin() + margin);
+        // the hull caches its bounding box, which includes the margin
+        static_cast<btConvexHullShape*>(shape)->recalcLocalAabb();
+      }
+      else
+      {
+        shape->setImplicitShapeDimensions(shape->getImplicitShapeDimensions() + btVector3(margin, margin, margin));
+      }
+    }
+  }
+
+  ~InflatedRobot()
+  {
+    for (auto& shape : grown_)
+    {
+      shape.shape->setImplicitShapeDimensions(shape.dimensions);
+      shape.shape->setMargin(shape.margin);
+      if (shape.shape->getShapeType() == CONVEX_HULL_SHAPE_PROXYTYPE)
+        static_cast<btConvexHullShape*>(shape.shape)->recalcLocalAabb();
+    }
+  }
+
+  InflatedRobot(const InflatedRobot&) = delete;
+  InflatedRobot& operator=(const InflatedRobot&) = delete;
+
+  explicit operator bool() const
+  {
+    return !grown_.empty();
+  }
+
+private:
+  struct GrownShape
+  {
+    btConvexInternalShape* shape;
+    btScalar margin;
+    btVector3 dimensions;
+  };
+
+  std::vector<GrownShape> grown_;
+};
+}  // namespace
 
 JacobianController::SingleResult::operator bool() const
 {
@@ -83,6 +171,23 @@ JacobianController::JacobianController(std::shared_ptr<rl::kin::Kinematics> kine
 
   random_engine_.seed(time(nullptr));
 
+  // the bullet shapes of rl keep their rl::sg::Shape as the user pointer of their collision objects
+  std::unordered_set<const rl::sg::Shape*> robot_shapes;
+  auto robot = bullet_scene_->getModel(0);
+  for (std::size_t b = 0; b < robot->getNumBodies(); ++b)
+    for (std::size_t s = 0; s < robot->getBody(b)->getNumShapes(); ++s)
+      robot_shapes.insert(robot->getBody(b)->getShape(s));
+
+  auto& objects = bullet_scene_->world->getCollisionObjectArray();
+  for (int i = 0; i < objects.size(); ++i)
+    if (robot_shapes.count(static_cast<const rl::sg::Shape*>(objects[i]->getUserPointer())))
+      robot_objects_.push_back(objects[i]);
+  link_reach_ = robotLinkReach(*kinematics_, *bullet_scene_);
+
+  revolute_chain_ = kinematics_->getOperationalDof() == 1;
+  for (std::size_t i = 0; i < kinematics_->getDof(); ++i)
+    revolute_chain_ = revolute_chain_ && kinematics_->isRevolute(i);
+
   if (viewer)
   {
     QObject::connect(this, SIGNAL(applyFunctionToScene(std::function<void(rl::sg::Scene&)>)), *viewer,
@@ -96,6 +201,23 @@ JacobianController::JacobianController(std::shared_ptr<rl::kin::Kinematics> kine
 JacobianController::SingleResult JacobianController::moveSingleParticle(const rl::math::Vector& initial_configuration,
                                                                         const rl::math::Transform& to_pose,
                                                                         const CollisionTypes& collision_types)
+{
+  return moveSingleParticle(initial_configuration, to_pose, collision_types, nullptr);
+}
+
+JacobianController::SingleResult JacobianController::moveSingleParticle(const rl::math::Vector& initial_configuration,
+                                                                        const rl::math::Transform& to_pose,
+                                                                        const CollisionTypes& collision_types,
+                                                                        RolloutTree& tree)
+{
+  return moveSingleParticle(initial_configuration, to_pose, collision_types, nullptr, &tree);
+}
+
+JacobianController::SingleResult JacobianController::moveSingleParticle(const rl::math::Vector& initial_configuration,
+                                                                        const rl::math::Transform& to_pose,
+                                                                        const CollisionTypes& collision_types,
+                                                                        std::vector<NominalStep>* nominal_steps,
+                                                                        RolloutTree* tree)
 {
   using namespace rl::math;
 
@@ -104,23 +226,48 @@ JacobianController::SingleResult JacobianController::moveSingleParticle(const rl
 
   Vector current_config = initial_configuration;
 
-  emit reset();
-  emit drawConfiguration(current_config);
-
   SingleResult result;
   result.trajectory.push_back(current_config);
 
+  // the required collisions seen up to the current node of the tree, shared by the nodes until the next contact
+  std::shared_ptr<const RequiredCollisionsCounter> required_counter_snapshot;
+  std::size_t current_node = 0;
+  if (tree)
+  {
+    auto& nodes = tree->nodes_;
+    if (nodes.empty() || nodes.front().configuration.size() != initial_configuration.size() ||
+        nodes.front().configuration != initial_configuration)
+    {
+      nodes.clear();
+      noisy_model_.setPosition(initial_configuration);
+      noisy_model_.updateFrames();
+      tree->add(initial_configuration, noisy_model_.forwardPosition(), 0, required_counter->clone());
+    }
+
+    current_node = tree->branch(to_pose);
+    current_config = nodes[current_node].configuration;
+    required_counter_snapshot = nodes[current_node].required_counter;
+    required_counter = required_counter_snapshot->clone();
+    result.trajectory = tree->trajectory(current_node);
+    tree->reused_steps_ += result.trajectory.size() - 1;
+  }
+
+  emit reset();
+  emit drawConfiguration(current_config);
+
   for (std::size_t i = 0; i < maximum_steps_; ++i)
   {
     auto q_dot = calculateQDot(current_config, to_pose, delta_);
 
     // arrived at the target pose
     if (q_dot.isZero())
+    {
       // if there were no required collisions at the start, or all of them were seen during the execution,
       // then it's a succesful termination
       return result.setSingleOutcome(required_counter->allRequiredPresent() ?
                                          SingleResult::Outcome::REACHED :
                                          SingleResult::Outcome::MISSED_REQUIRED_COLLISIONS);
+    }
 
     current_config += q_dot;
 
@@ -134,17 +281,20 @@ JacobianController::SingleResult JacobianController::moveSingleParticle(const rl
     noisy_model_.updateFrames();
     noisy_model_.updateJacobian();
     noisy_model_.updateJacobianInverse();
-    noisy_model_.isColliding();
 
-    if (noisy_model_.getDof() > 3 && noisy_model_.getManipulabilityMeasure() < 1.0e-3)
+    if (noisy_model_.getDof() > 3 && noisy_model_.getManipulabilityMeasure() < singularity_threshold)
       result.outcomes.insert(SingleResult::Outcome::SINGULARITY);
 
+    noisy_model_.isColliding();
     auto collision_constraints_check =
         checkCollisionConstraints(noisy_model_.scene->getLastCollisions(), collision_types, *required_counter);
     // if the collision constraints were violated, failures are not empty
     std::copy(collision_constraints_check.failures.begin(), collision_constraints_check.failures.end(),
               std::inserter(result.outcomes, result.outcomes.begin()));
 
+    if (nominal_steps)
+      nominal_steps->push_back(makeNominalStep(current_config, !noisy_model_.scene->getLastCollisions().empty()));
+
     if (!result.outcomes.empty())
       return result;
 
@@ -152,11 +302,203 @@ JacobianController::SingleResult JacobianController::moveSingleParticle(const rl
     // and requirements were obeyed
     else if (collision_constraints_check.success_termination)
       return result.setSingleOutcome(SingleResult::Outcome::ACCEPTABLE_COLLISION);
+
+    // the step passed every check, later rollouts may continue from it
+    if (tree)
+    {
+      if (!noisy_model_.scene->getLastCollisions().empty())
+        required_counter_snapshot = required_counter->clone();
+      current_node = tree->add(current_config, noisy_model_.forwardPosition(), current_node, required_counter_snapshot);
+    }
   }
 
   return result.setSingleOutcome(SingleResult::Outcome::STEPS_LIMIT);
 }
 
+JacobianController::SingleResult JacobianController::moveJoints(const rl::math::Vector& initial_configuration,
+                                                                const rl::math::Vector& target_configuration,
+                                                                const CollisionTypes& collision_types)
+{
+  using namespace rl::math;
+
+  Vector difference = target_configuration - initial_configuration;
+  auto steps = std::max<std::size_t>(1, static_cast<std::size_t>(std::ceil(difference.norm() / delta_)));
+
+  std::vector<Vector> trajectory;
+  for (std::size_t i = 0; i <= steps; ++i)
+    trajectory.push_back(initial_configuration + difference * (static_cast<Real>(i) / steps));
+
+  return checkTrajectory(trajectory, collision_types);
+}
+
+JacobianController::SingleResult JacobianController::checkTrajectory(const std::vector<rl::math::Vector>& trajectory,
+                                                                     const CollisionTypes& collision_types)
+{
+  return checkTrajectory(trajectory, collision_types, nullptr, nullptr);
+}
+
+JacobianController::SingleResult JacobianController::checkTrajectory(const std::vector<rl::math::Vector>& trajectory,
+                                                                     const CollisionTypes& collision_types,
+                                                                     const std::vector<Aabb>& changed_boxes,
+                                                                     std::size_t* collision_queries)
+{
+  return checkTrajectory(trajectory, collision_types, &changed_boxes, collision_queries);
+}
+
+JacobianController::SingleResult JacobianController::checkTrajectory(const std::vector<rl::math::Vector>& trajectory,
+                                                                     const CollisionTypes& collision_types,
+                                                                     const std::vector<Aabb>* changed_boxes,
+                                                                     std::size_t* collision_queries)
+{
+  auto required_counter = collision_types.makeRequiredCollisionsCounter();
+
+  // the contacts of skipped steps would be missing from the count of required collisions
+  if (!required_counter->allRequiredPresent())
+    changed_boxes = nullptr;
+
+  if (collision_queries)
+    *collision_queries = 0;
+
+  emit reset();
+
+  SingleResult result;
+  Aabb previous_bounds;
+  for (std::size_t i = 0; i < trajectory.size(); ++i)
+  {
+    auto& configuration = trajectory[i];
+    result.trajectory.push_back(configuration);
+    emit drawConfiguration(configuration);
+
+    if (!noisy_model_.isValid(configuration))
+      result.outcomes.insert(SingleResult::Outcome::JOINT_LIMIT);
+
+    noisy_model_.setPosition(configuration);
+    noisy_model_.updateFrames();
+    noisy_model_.updateJacobian();
+    noisy_model_.updateJacobianInverse();
+
+    if (noisy_model_.getDof() > 3 && noisy_model_.getManipulabilityMeasure() < singularity_threshold)
+      result.outcomes.insert(SingleResult::Outcome::SINGULARITY);
+
+    if (changed_boxes && i + 1 < trajectory.size())
+    {
+      auto bounds = Aabb::ofFrames(*kinematics_, link_reach_);
+      Aabb swept_bounds = bounds;
+      swept_bounds.extend(previous_bounds);
+      previous_bounds = bounds;
+
+      if (std::none_of(changed_boxes->begin(), changed_boxes->end(),
+                       [&swept_bounds](const Aabb& box) { return box.intersects(swept_bounds); }))
+      {
+        if (!result.outcomes.empty())
+          return result;
+        continue;
+      }
+    }
+
+    if (collision_queries)
+      ++*collision_queries;
+
+    noisy_model_.isColliding();
+    auto collision_constraints_check =
+        checkCollisionConstraints(noisy_model_.scene->getLastCollisions(), collision_types, *required_counter);
+    std::copy(collision_constraints_check.failures.begin(), collision_constraints_check.failures.end(),
+              std::inserter(result.outcomes, result.outcomes.begin()));
+
+    if (!result.outcomes.empty())
+      return result;
+    else if (collision_constraints_check.success_termination)
+      return result.setSingleOutcome(SingleResult::Outcome::ACCEPTABLE_COLLISION);
+  }
+
+  return result.setSingleOutcome(required_counter->allRequiredPresent() ?
+                                     SingleResult::Outcome::REACHED :
+                                     SingleResult::Outcome::MISSED_REQUIRED_COLLISIONS);
+}
+
+std::vector<std::pair<std::string, std::string>>
+JacobianController::contactsAt(const rl::math::Vector& configuration)
+{
+  noisy_model_.setPosition(configuration);
+  noisy_model_.updateFrames();
+  noisy_model_.isColliding();
+  return transformCollisionMapToNamePairs(noisy_model_.scene->getLastCollisions());
+}
+
+std::size_t JacobianController::RolloutTree::add(const rl::math::Vector& configuration, const rl::math::Transform& pose,
+                                                 std::size_t parent,
+                                                 std::shared_ptr<const RequiredCollisionsCounter> required_counter)
+{
+  nodes_.push_back({ configuration, pose, parent, required_counter });
+  return nodes_.size() - 1;
+}
+
+std::size_t JacobianController::RolloutTree::branch(const rl::math::Transform& target) const
+{
+  using namespace rl::math;
+
+  auto& initial_pose = nodes_.front().pose;
+  Vector3 way = target.translation() - initial_pose.translation();
+  Quaternion initial_rotation(initial_pose.linear());
+  Quaternion target_rotation(target.linear());
+  Real way_rotation = initial_rotation.angularDistance(target_rotation);
+
+  auto remaining = [&](const Node& node, const Quaternion& rotation) {
+    return (target.translation() - node.pose.translation()).norm() +
+           rotation_distance_weight * rotation.angularDistance(target_rotation);
+  };
+
+  // a node is on the way if it and all nodes before it are close to the interpolation from the initial pose to the
+  // target. Parents come before their children, so one pass decides for all nodes
+  std::vector<bool> on_the_way(nodes_.size(), false);
+  on_the_way[0] = true;
+  std::size_t best_node = 0;
+  Real best_remaining = remaining(nodes_.front(), initial_rotation);
+
+  for (std::size_t i = 1; i < nodes_.size(); ++i)
+  {
+    auto& node = nodes_[i];
+    if (!on_the_way[node.parent])
+      continue;
+
+    Vector3 offset = node.pose.translation() - initial_pose.translation();
+    Quaternion rotation(node.pose.linear());
+
+    // the fraction of the way done, by translation unless the target differs only in orientation
+    Real progress = 0;
+    if (way.norm() > position_tolerance_)
+      progress = offset.dot(way) / way.squaredNorm();
+    else if (way_rotation > rotation_tolerance_)
+      progress = initial_rotation.angularDistance(rotation) / way_rotation;
+    progress = std::min<Real>(std::max<Real>(progress, 0), 1);
+
+    if ((offset - progress * way).norm() > position_tolerance_ ||
+        initial_rotation.slerp(progress, target_rotation).angularDistance(rotation) > rotation_tolerance_)
+      continue;
+
+    on_the_way[i] = true;
+    Real node_remaining = remaining(node, rotation);
+    if (node_remaining < best_remaining)
+    {
+      best_node = i;
+      best_remaining = node_remaining;
+    }
+  }
+
+  return best_node;
+}
+
+std::vector<rl::math::Vector> JacobianController::RolloutTree::trajectory(std::size_t node) const
+{
+  std::vector<rl::math::Vector> configurations;
+  for (; node != 0; node = nodes_[node].parent)
+    configurations.push_back(nodes_[node].configuration);
+  configurations.push_back(nodes_.front().configuration);
+
+  std::reverse(configurations.begin(), configurations.end());
+  return configurations;
+}
+
 // TODO try to resolve code duplication between this and moveSingleParticle
 JacobianController::BeliefResult JacobianController::moveBelief(const rl::math::Vector& initial_configuration,
                                                                 const rl::math::Transform& to_pose,
@@ -168,88 +510,331 @@ JacobianController::BeliefResult JacobianController::moveBelief(const rl::math::
   using rl::plan::Particle;
 
   BeliefResult result;
-  // phase one: move a single particle without noise to find out the trajectory
-  result.no_noise_test_result = moveSingleParticle(initial_configuration, to_pose, collision_types);
-
-  if (!result)
+  // phase one: move a single particle without noise to find out the trajectory. If the particles are allowed to
+  // estimate their kinematics from it, cache them along the way
+  std::vector<NominalStep> nominal_steps;
+  bool use_nominal_steps = settings.perturbation_tolerance > 0;
+  result.no_noise_test_result = moveSingleParticle(initial_configuration, to_pose, collision_types,
+                                                   use_nominal_steps ? &nominal_steps : nullptr);
+
+  if (!result.no_noise_test_result)
     return result;
 
-  result.particle_results = std::vector<SingleResult>(settings.number_of_particles);
+  // a contact at a step makes its neighbours near a contact too, the particles can reach it a step earlier or later
+  std::vector<bool> in_contact;
+  for (auto& step : nominal_steps)
+    in_contact.push_back(step.near_contact);
+  for (std::size_t i = 0; i < nominal_steps.size(); ++i)
+    nominal_steps[i].near_contact =
+        in_contact[i] || (i > 0 && in_contact[i - 1]) || (i + 1 < in_contact.size() && in_contact[i + 1]);
 
   *noisy_model_.motionError = settings.joints_std_error;
   *noisy_model_.initialError = settings.initial_std_error;
 
-  // for every particle, sample initial noise, and then execute the trajectory with motion noise
-  for (std::size_t i = 0; i < settings.number_of_particles; ++i)
+  // phase two: propagate the belief. In adaptive mode particles are added in batches of number_of_particles until
+  // the confidence interval of the success probability is narrow enough or the cap on particles is reached
+  result.particle_results = std::vector<SingleResult>();
+  auto& particle_results = *result.particle_results;
+  std::size_t batch_size = settings.number_of_particles;
+  while (batch_size > 0)
   {
-    Vector current_config(initial_configuration.size());
-    noisy_model_.sampleInitialError(current_config);
-    current_config += initial_configuration;
+    auto batch_results = propagateParticles(result.no_noise_test_result.trajectory,
+                                            use_nominal_steps ? &nominal_steps : nullptr, collision_types, settings,
+                                            batch_size);
+    particle_results.insert(particle_results.end(), batch_results.begin(), batch_results.end());
 
-    // count the required collisions for this particle
-    auto required_counter = collision_types.makeRequiredCollisionsCounter();
+    if (!settings.adaptive || particle_results.size() >= settings.maximum_particles)
+      break;
 
-    auto& particle_result = result.particle_results->at(i);
-    particle_result.trajectory.push_back(current_config);
+    auto successes = std::count_if(particle_results.begin(), particle_results.end(),
+                                   [](const SingleResult& r) { return static_cast<bool>(r); });
+    if (confidenceIntervalWidth(successes, particle_results.size()) <= settings.confidence_interval_width)
+      break;
 
-    // current_error is used to store accumulated error. The target of the particle for a step
-    // is a trajectory configuration for that step plus the accumulated error
-    Vector current_error = current_config - result.no_noise_test_result.trajectory.front();
+    batch_size = std::min(settings.number_of_particles, settings.maximum_particles - particle_results.size());
+  }
 
-    emit reset();
-    emit drawConfiguration(current_config);
+  return result;
+}
 
-    // execute the steps of the trajectory
-    for (std::size_t j = 1; j < result.no_noise_test_result.trajectory.size(); ++j)
+std::vector<JacobianController::SingleResult>
+JacobianController::propagateParticles(const std::vector<rl::math::Vector>& trajectory,
+                                       const std::vector<NominalStep>* nominal_steps,
+                                       const CollisionTypes& collision_types, const MoveBeliefSettings& settings,
+                                       std::size_t number_of_particles)
+{
+  using namespace rl::math;
+
+  std::vector<SingleResult> particle_results(number_of_particles);
+  std::size_t dof = trajectory.front().size();
+
+  // all particles are advanced together one step of the trajectory at a time. The noise and the joint limits are
+  // handled for the whole batch, kinematics and collisions for every particle that is still running
+  auto& particles = particles_;
+  particles.resize(dof, number_of_particles);
+  particles.sampleInitial(trajectory.front(), settings.initial_std_error, random_engine_);
+
+  Vector minimum, maximum;
+  noisy_model_.getMinimum(minimum);
+  noisy_model_.getMaximum(maximum);
+
+  // count the required collisions for every particle
+  std::vector<std::shared_ptr<RequiredCollisionsCounter>> required_counters;
+  std::vector<unsigned char> finished(number_of_particles, false);
+
+  emit reset();
+  for (std::size_t i = 0; i < number_of_particles; ++i)
+  {
+    Vector initial_particle_configuration;
+    required_counters.push_back(collision_types.makeRequiredCollisionsCounter());
+    particles.getConfiguration(i, initial_particle_configuration);
+    particle_results[i].trajectory.reserve(trajectory.size());
+    particle_results[i].trajectory.push_back(initial_particle_configuration);
+    emit drawConfiguration(initial_particle_configuration);
+  }
+
+  std::vector<unsigned char> joint_limit_violations;
+  std::vector<std::size_t> running;
+  // the configurations are overwritten in place every step, only the entries of running particles are read
+  auto& configurations = particle_configurations_;
+  configurations.resize(number_of_particles);
+
+  // execute the steps of the trajectory
+  for (std::size_t j = 1; j < trajectory.size(); ++j)
+  {
+    // the target of a particle for a step is the trajectory configuration for that step plus the accumulated error
+    particles.sampleNoise(settings.joints_std_error, finished, random_engine_);
+    particles.step(trajectory[j]);
+    particles.checkJointLimits(minimum, maximum, joint_limit_violations);
+
+    running.clear();
+    for (std::size_t i = 0; i < number_of_particles; ++i)
     {
-      // target with the inclusion of accumulated error
-      Vector target_with_error = result.no_noise_test_result.trajectory[j] + current_error;
-      Vector noise(initial_configuration.size());
-      noisy_model_.sampleMotionError(noise);
-      // move the particle all the way to target_with_error applying noise
-      noisy_model_.interpolateNoisy(current_config, target_with_error, 1, noise, current_config);
+      if (finished[i])
+        continue;
 
-      particle_result.trajectory.push_back(current_config);
-      current_error += noise;
+      running.push_back(i);
+      particles.getConfiguration(i, configurations[i]);
+      particle_results[i].trajectory.push_back(configurations[i]);
 
-      if (!noisy_model_.isValid(current_config))
-        particle_result.outcomes.insert(SingleResult::Outcome::JOINT_LIMIT);
+      if (joint_limit_violations[i])
+        particle_results[i].outcomes.insert(SingleResult::Outcome::JOINT_LIMIT);
+    }
 
-      noisy_model_.setPosition(current_config);
-      noisy_model_.updateFrames();
-      noisy_model_.updateJacobian();
-      noisy_model_.updateJacobianInverse();
-      noisy_model_.isColliding();
+    // the model must be updated to the configuration of the particle before calling this
+    auto nominal_step = nominal_steps ? &(*nominal_steps)[j - 1] : nullptr;
+    auto finishStep = [&](std::size_t i, const rl::sg::CollisionMap& collisions) {
+      auto& particle_result = particle_results[i];
 
-      if (noisy_model_.getDof() > 3 && noisy_model_.getManipulabilityMeasure() < 1.0e-3)
+      if (noisy_model_.getDof() > 3 &&
+          manipulabilityMeasure(configurations[i], nominal_step, settings.perturbation_tolerance) <
+              singularity_threshold)
         particle_result.outcomes.insert(SingleResult::Outcome::SINGULARITY);
 
-      auto collision_constraints_check =
-          checkCollisionConstraints(noisy_model_.scene->getLastCollisions(), collision_types, *required_counter);
+      auto collision_constraints_check = checkCollisionConstraints(collisions, collision_types, *required_counters[i]);
       std::copy(collision_constraints_check.failures.begin(), collision_constraints_check.failures.end(),
                 std::inserter(particle_result.outcomes, particle_result.outcomes.begin()));
 
       // there was one or more failures, execution for this particle is finished
       if (!particle_result.outcomes.empty())
-        break;
+        finished[i] = true;
 
       // a terminating collision was seen and all other constraints were obeyed
-      if (collision_constraints_check.success_termination)
+      else if (collision_constraints_check.success_termination)
       {
         particle_result.setSingleOutcome(SingleResult::Outcome::ACCEPTABLE_COLLISION);
-        break;
+        finished[i] = true;
+      }
+    };
+
+    // without clustering every particle is a cluster of its own and gets its own collision query
+    std::vector<ParticleCluster> clusters;
+    if (settings.cluster_collision_queries)
+      clusters = clusterParticles(configurations, running, settings);
+    else
+      for (auto i : running)
+        clusters.push_back({ { i }, 0 });
+
+    const rl::sg::CollisionMap no_collisions;
+    for (auto& cluster : clusters)
+    {
+      // a single query of the leader with the robot grown by the spread of the cluster covers every member: no link of
+      // a member is farther than the spread from the link of the leader, so nothing can touch a member, not even
+      // another link of it, if nothing touches the grown leader
+      bool members_free = false;
+      if (cluster.members.size() > 1)
+      {
+        noisy_model_.setPosition(configurations[cluster.members.front()]);
+        noisy_model_.updateFrames();
+
+        InflatedRobot inflated(robot_objects_, cluster.spread + settings.cluster_safety_margin);
+        if (inflated)
+        {
+          noisy_model_.isColliding();
+          members_free = noisy_model_.scene->getLastCollisions().empty();
+        }
+      }
+
+      // otherwise the cluster splits back into individual queries
+      for (auto member : cluster.members)
+      {
+        noisy_model_.setPosition(configurations[member]);
+        noisy_model_.updateFrames();
+
+        if (members_free)
+          finishStep(member, no_collisions);
+        else
+        {
+          noisy_model_.isColliding();
+          finishStep(member, noisy_model_.scene->getLastCollisions());
+        }
       }
     }
+  }
+
+  // the particles that are still running have successfully executed the whole trajectory
+  // TODO unclear whether it should be reached: it can deviate pretty far from the target pose. It does not
+  // mean the same as REACHED in moveSingleParticle
+  for (std::size_t i = 0; i < number_of_particles; ++i)
+    if (!finished[i])
+      particle_results[i].setSingleOutcome(SingleResult::Outcome::REACHED);
+
+  return particle_results;
+}
 
-    // have successfully executed the whole trajectory
-    // TODO unclear whether it should be reached: it can deviate pretty far from the target pose. It does not
-    // mean the same as REACHED in moveSingleParticle
-    particle_result.setSingleOutcome(SingleResult::Outcome::REACHED);
+double JacobianController::confidenceIntervalWidth(std::size_t successes, std::size_t trials)
+{
+  // Wilson score interval, which stays meaningful for success rates close to 0 and 1
+  const double z = 1.96;
+  double n = static_cast<double>(trials);
+  double p = successes / n;
+  return 2 * z * std::sqrt(p * (1 - p) / n + z * z / (4 * n * n)) / (1 + z * z / n);
+}
+
+JacobianController::NominalStep JacobianController::makeNominalStep(const rl::math::Vector& configuration,
+                                                                   bool in_contact)
+{
+  NominalStep step;
+  step.configuration = configuration;
+  step.manipulability = noisy_model_.getManipulabilityMeasure();
+  step.near_contact = in_contact;
+
+  if (revolute_chain_)
+  {
+    step.jacobian = kinematics_->getJacobian();
+    step.jacobian_derivatives = jacobianDerivatives(step.jacobian);
+  }
+
+  return step;
+}
+
+std::vector<rl::math::Matrix> JacobianController::jacobianDerivatives(const rl::math::Matrix& jacobian)
+{
+  using namespace rl::math;
+
+  // column j of the jacobian is (z_j x (p - p_j), z_j) for the axis z_j of joint j through p_j and the tool position
+  // p. Joint i turns the axis and the lever of every joint from i on about z_i, and moves the tool, and with it the
+  // lever of every joint before i, by column i
+  std::size_t dof = jacobian.cols();
+  std::vector<Matrix> result(dof, Matrix::Zero(6, dof));
+  for (std::size_t i = 0; i < dof; ++i)
+  {
+    Vector3 linear_i = jacobian.col(i).head<3>();
+    Vector3 angular_i = jacobian.col(i).tail<3>();
+    for (std::size_t j = 0; j < dof; ++j)
+    {
+      Vector3 linear_j = jacobian.col(j).head<3>();
+      Vector3 angular_j = jacobian.col(j).tail<3>();
+      if (i <= j)
+      {
+        result[i].col(j).head<3>() = angular_i.cross(linear_j);
+        result[i].col(j).tail<3>() = angular_i.cross(angular_j);
+      }
+      else
+        result[i].col(j).head<3>() = angular_j.cross(linear_i);
+    }
   }
 
   return result;
 }
 
+rl::math::Real JacobianController::manipulabilityMeasure(const rl::math::Vector& configuration,
+                                                         const NominalStep* nominal, double tolerance)
+{
+  if (nominal && !nominal->near_contact && !nominal->jacobian_derivatives.empty())
+  {
+    rl::math::Vector deviation = configuration - nominal->configuration;
+    if (deviation.lpNorm<Eigen::Infinity>() <= tolerance)
+    {
+      rl::math::Matrix jacobian = nominal->jacobian;
+      for (int i = 0; i < deviation.size(); ++i)
+        jacobian += nominal->jacobian_derivatives[i] * deviation(i);
+
+      // close to the threshold the second order terms could decide the outcome
+      auto estimate = std::sqrt((jacobian * jacobian.transpose()).determinant());
+      if (estimate > 2 * singularity_threshold)
+        return estimate;
+    }
+  }
+
+  // the measure needs the jacobian only, not its inverse
+  noisy_model_.updateJacobian();
+  return noisy_model_.getManipulabilityMeasure();
+}
+
+std::vector<JacobianController::ParticleCluster>
+JacobianController::clusterParticles(const std::vector<rl::math::Vector>& configurations,
+                                     const std::vector<std::size_t>& particles, const MoveBeliefSettings& settings)
+{
+  using namespace rl::math;
+
+  // the link frames of every particle, computed on the kinematics only
+  std::vector<std::vector<Transform>> frames(configurations.size());
+  for (auto i : particles)
+  {
+    kinematics_->setPosition(configurations[i]);
+    kinematics_->updateFrames();
+    for (std::size_t b = 0; b < kinematics_->getBodies(); ++b)
+      frames[i].push_back(kinematics_->getFrame(b));
+  }
+
+  // an upper bound of how far any point of any link moves between the two particles
+  auto displacement = [this, &frames](std::size_t first, std::size_t second) {
+    Real result = 0;
+    for (std::size_t b = 0; b < frames[first].size(); ++b)
+    {
+      auto& a = frames[first][b];
+      auto& c = frames[second][b];
+      Real angle = AngleAxis(a.linear().transpose() * c.linear()).angle();
+      result = std::max(result, (a.translation() - c.translation()).norm() + angle * link_reach_);
+    }
+    return result;
+  };
+
+  // greedy leader clustering: a particle joins the first cluster whose leader is close enough
+  std::vector<ParticleCluster> clusters;
+  for (auto i : particles)
+  {
+    bool assigned = false;
+    for (auto& cluster : clusters)
+    {
+      auto bound = displacement(cluster.members.front(), i);
+      if (bound <= settings.cluster_radius)
+      {
+        cluster.members.push_back(i);
+        cluster.spread = std::max(cluster.spread, bound);
+        assigned = true;
+        break;
+      }
+    }
+
+    if (!assigned)
+      clusters.push_back({ { i }, 0 });
+  }
+
+  return clusters;
+}
+
 rl::math::Vector JacobianController::calculateQDot(const rl::math::Vector& configuration,
                                                    const rl::math::Transform& goal_pose, double delta)
 {
@@ -356,3 +941,26 @@ JacobianController::BeliefResult::operator bool() const
 
   return std::all_of(particle_results->begin(), particle_results->end(), [](const SingleResult& r) { return r; });
 }
+
+double JacobianController::BeliefResult::successRate() const
+{
+  if (!no_noise_test_result || particle_results->empty())
+    return 0;
+
+  auto successful = std::count_if(particle_results->begin(), particle_results->end(),
+                                  [](const SingleResult& r) { return static_cast<bool>(r); });
+  return static_cast<double>(successful) / particle_results->size();
+}
+
+std::map<JacobianController::SingleResult::Outcome, std::size_t> JacobianController::BeliefResult::outcomeCounts() const
+{
+  std::map<SingleResult::Outcome, std::size_t> counts;
+  if (!no_noise_test_result)
+    return counts;
+
+  for (auto& particle_result : *particle_results)
+    for (auto outcome : particle_result.outcomes)
+      ++counts[outcome];
+
+  return counts;
+}
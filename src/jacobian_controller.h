@@ -10,7 +10,10 @@
 #include <rl/plan/UniformSampler.h>
 #include "Viewer.h"
 #include "collision_types.h"
+#include "aabb.h"
+#include "particle_batch.h"
 #include <unordered_map>
+#include <map>
 
 class WorkspaceSampler;
 
@@ -69,17 +72,103 @@ public:
     boost::optional<std::vector<SingleResult>> particle_results;
 
     /* BeliefResult converts to true when no_noise_test_result is successful and every
-     * particle's SingleResult is successful.
+     * particle's SingleResult is successful. The number of particles used is the size of particle_results.
      */
     operator bool() const;
+
+    /* The fraction of particles with a successful outcome. Zero if the noise-free test failed. */
+    double successRate() const;
+
+    /* The number of particles with every outcome. Empty if the noise-free test failed. */
+    std::map<SingleResult::Outcome, std::size_t> outcomeCounts() const;
   };
 
   /* Particle count and noise settings for moveBelief. */
   struct MoveBeliefSettings
   {
+    /* The number of particles, or the size of a batch in adaptive mode. */
     std::size_t number_of_particles;
     rl::math::Vector initial_std_error;
     rl::math::Vector joints_std_error;
+
+    /* Maximum absolute joint deviation from the noise-free trajectory up to which a particle estimates its
+     * kinematics from the noise-free pass instead of recomputing them. Zero disables the estimate.
+     */
+    double perturbation_tolerance = 0;
+
+    /* Keep adding batches of number_of_particles particles until the 95% confidence interval of the success
+     * probability is at most confidence_interval_width wide, or maximum_particles particles were used.
+     */
+    bool adaptive = false;
+    double confidence_interval_width = 0.1;
+    std::size_t maximum_particles = 1000;
+
+    /* Group particles with close link frames and run a single collision query per group, for its leader with the
+     * robot grown by the spread of the group and the safety margin. The members are queried individually only if the
+     * grown robot is in contact. Robots with shapes other than hulls, boxes, cylinders and spheres cannot be grown,
+     * they are always queried individually.
+     */
+    bool cluster_collision_queries = false;
+    /* Maximum displacement of any link point between a member and the leader of its group. */
+    double cluster_radius = 0.005;
+    /* Growth of the robot on top of the spread of a group, covers the contact threshold of bullet. */
+    double cluster_safety_margin = 0.02;
+  };
+
+  /* Checked steps of earlier rollouts of moveSingleParticle from the same initial configuration, in the same scene and
+   * with the same collision types. A rollout to a new target continues from the step closest to it among the steps
+   * that lie on the motion of the end effector from the initial pose to the target, so that prefixes which were
+   * checked already are not simulated again. Only meant for targets close to each other, like the samples of one
+   * request.
+   */
+  class RolloutTree
+  {
+  public:
+    /* @param position_tolerance How far a step may be from the straight line from the initial position to the target
+     * position to be reused for it.
+     * @param rotation_tolerance How far the orientation of a step may be from the interpolated orientation there.
+     */
+    RolloutTree(double position_tolerance = 0.01, double rotation_tolerance = 0.05)
+      : position_tolerance_(position_tolerance), rotation_tolerance_(rotation_tolerance)
+    {
+    }
+
+    std::size_t size() const
+    {
+      return nodes_.size();
+    }
+
+    /* The number of steps all rollouts did not simulate because they were reused. */
+    std::size_t reusedSteps() const
+    {
+      return reused_steps_;
+    }
+
+  private:
+    friend class JacobianController;
+
+    struct Node
+    {
+      rl::math::Vector configuration;
+      rl::math::Transform pose;
+      std::size_t parent;
+      /* The required collisions seen from the initial configuration up to this step. */
+      std::shared_ptr<const RequiredCollisionsCounter> required_counter;
+    };
+
+    std::size_t add(const rl::math::Vector& configuration, const rl::math::Transform& pose, std::size_t parent,
+                    std::shared_ptr<const RequiredCollisionsCounter> required_counter);
+
+    /* The node a rollout to target continues from, the initial configuration if no other node lies on the way. */
+    std::size_t branch(const rl::math::Transform& target) const;
+
+    /* The configurations from the initial one to node. */
+    std::vector<rl::math::Vector> trajectory(std::size_t node) const;
+
+    double position_tolerance_;
+    double rotation_tolerance_;
+    std::vector<Node> nodes_;
+    std::size_t reused_steps_ = 0;
   };
 
   /* Create a jacobian controller.
@@ -107,6 +196,39 @@ public:
   SingleResult moveSingleParticle(const rl::math::Vector& initial_configuration, const rl::math::Transform& target_pose,
                                   const CollisionTypes& collision_types);
 
+  /* moveSingleParticle that starts from a checked step of the earlier rollouts in tree, if one lies on the way to
+   * target_pose, and adds the steps it checks to tree. The trajectory of the result still starts at
+   * initial_configuration. A tree from another initial configuration is cleared first.
+   */
+  SingleResult moveSingleParticle(const rl::math::Vector& initial_configuration, const rl::math::Transform& target_pose,
+                                  const CollisionTypes& collision_types, RolloutTree& tree);
+
+  /* Move in a straight line in joint space from initial configuration to target configuration, in steps as long as
+   * the steps of moveSingleParticle, and check every step like moveSingleParticle does.
+   */
+  SingleResult moveJoints(const rl::math::Vector& initial_configuration, const rl::math::Vector& target_configuration,
+                          const CollisionTypes& collision_types);
+
+  /* Check the joint limits, singularities and collision constraints along a trajectory that was found earlier, e.g.
+   * in a scene with other bounding boxes, without controlling the robot. The result ends at the first step that
+   * fails or terminates.
+   */
+  SingleResult checkTrajectory(const std::vector<rl::math::Vector>& trajectory, const CollisionTypes& collision_types);
+
+  /* checkTrajectory for a trajectory that passed it in a scene that differed only by the boxes in changed_boxes,
+   * their bounds before and after the change. A step whose swept bounds, from the step before to it, do not intersect
+   * a changed box keeps the collisions it had and is not queried. The last step, where the trajectory may have
+   * terminated on a contact, is always queried, and so is every step if collision_types require collisions, the
+   * contacts of a skipped step cannot be counted.
+   *
+   * @param collision_queries If given, set to the number of steps that were queried for collisions.
+   */
+  SingleResult checkTrajectory(const std::vector<rl::math::Vector>& trajectory, const CollisionTypes& collision_types,
+                               const std::vector<Aabb>& changed_boxes, std::size_t* collision_queries = nullptr);
+
+  /* The pairs of shape names in contact at configuration, the robot part first. */
+  std::vector<std::pair<std::string, std::string>> contactsAt(const rl::math::Vector& configuration);
+
   /* Create a belief in initial configuration and propagate it to the target pose using jacobian control and obeying
    * collision constraints. Done in two phases: first, a single particle is moved without noise to target pose.
    * If successful, the trajectory of the single particle is then repeated with multiple particles, sampling initial
@@ -122,8 +244,37 @@ public:
   BeliefResult moveBelief(const rl::math::Vector& initial_configuration, const rl::math::Transform& target_pose,
                           const CollisionTypes& collision_types, MoveBeliefSettings settings);
 
+  /* The largest distance of any point of a link from its frame origin, from the bullet shapes of the robot. */
+  rl::math::Real linkReach() const
+  {
+    return link_reach_;
+  }
+
 private:
   typedef std::vector<std::pair<std::string, std::string>> CollisionPairs;
+
+  /* Kinematic quantities of one step of the noise-free trajectory, cached for the particles of moveBelief. */
+  struct NominalStep
+  {
+    rl::math::Vector configuration;
+    rl::math::Real manipulability;
+    /* The jacobian at configuration and its derivative by every joint, for a first-order estimate of the jacobian of
+     * a particle. Both are empty if the robot is not a chain of revolute joints with a single tool.
+     */
+    rl::math::Matrix jacobian;
+    std::vector<rl::math::Matrix> jacobian_derivatives;
+    /* Whether the noise-free particle was in contact at this step or at one of the neighbouring steps. */
+    bool near_contact;
+  };
+
+  /* Particles of moveBelief sharing one collision query in a step. The first member is the leader. */
+  struct ParticleCluster
+  {
+    std::vector<std::size_t> members;
+    /* Upper bound of the displacement of any link point between a member and the leader. */
+    rl::math::Real spread;
+  };
+
   struct CollisionConstraintsCheck
   {
     std::set<SingleResult::Outcome> failures;
@@ -147,6 +298,47 @@ private:
                                                       const CollisionTypes& collision_types,
                                                       RequiredCollisionsCounter& required_counter);
 
+  /* moveSingleParticle that additionally fills nominal_steps, if given, with one entry per trajectory step after the
+   * initial configuration. If tree is given, the rollout starts from it and adds its checked steps to it.
+   */
+  SingleResult moveSingleParticle(const rl::math::Vector& initial_configuration, const rl::math::Transform& target_pose,
+                                  const CollisionTypes& collision_types, std::vector<NominalStep>* nominal_steps,
+                                  RolloutTree* tree = nullptr);
+
+  /* checkTrajectory that skips the collision queries of steps away from changed_boxes, if they are given. */
+  SingleResult checkTrajectory(const std::vector<rl::math::Vector>& trajectory, const CollisionTypes& collision_types,
+                               const std::vector<Aabb>* changed_boxes, std::size_t* collision_queries);
+
+  /* Propagate number_of_particles particles along the noise-free trajectory. nominal_steps, if given, must
+   * describe trajectory as filled by moveSingleParticle.
+   */
+  std::vector<SingleResult> propagateParticles(const std::vector<rl::math::Vector>& trajectory,
+                                               const std::vector<NominalStep>* nominal_steps,
+                                               const CollisionTypes& collision_types,
+                                               const MoveBeliefSettings& settings, std::size_t number_of_particles);
+
+  /* Width of the 95% Wilson score interval of a success probability. */
+  static double confidenceIntervalWidth(std::size_t successes, std::size_t trials);
+
+  /* Create the cache entry for configuration. The model and its jacobian must already be updated to configuration. */
+  NominalStep makeNominalStep(const rl::math::Vector& configuration, bool in_contact);
+
+  /* The derivatives of jacobian by every joint, for a chain of revolute joints with a single tool. */
+  static std::vector<rl::math::Matrix> jacobianDerivatives(const rl::math::Matrix& jacobian);
+
+  /* The manipulability measure at configuration. If nominal is given and configuration deviates from it by at most
+   * tolerance, the measure is taken from the first-order estimate of the jacobian, unless the noise-free particle was
+   * near a contact or the estimate is close to the singularity threshold. Otherwise the jacobian is recomputed. The
+   * frames of the model must already be updated to configuration.
+   */
+  rl::math::Real manipulabilityMeasure(const rl::math::Vector& configuration, const NominalStep* nominal,
+                                       double tolerance);
+
+  /* Group particles, given by their indices into configurations, by the displacement of their link frames. */
+  std::vector<ParticleCluster> clusterParticles(const std::vector<rl::math::Vector>& configurations,
+                                                const std::vector<std::size_t>& particles,
+                                                const MoveBeliefSettings& settings);
+
   rl::math::Vector calculateQDot(const rl::math::Vector& configuration, const rl::math::Transform& goal_pose,
                                  double delta);
   void moveBelief(rl::plan::BeliefState& belief, const std::vector<rl::math::Real>& q_dots);
@@ -162,6 +354,16 @@ private:
 
   std::mt19937 random_engine_;
 
+  /* Particle storage of propagateParticles, kept across calls so the batches of moveBelief reuse their buffers. */
+  ParticleBatch particles_;
+  std::vector<rl::math::Vector> particle_configurations_;
+
+  /* The collision objects of the shapes of the robot in bullet_scene_. */
+  std::vector<btCollisionObject*> robot_objects_;
+  rl::math::Real link_reach_;
+  /* Whether the jacobian derivatives of the nominal steps can be computed from the jacobian alone. */
+  bool revolute_chain_;
+
 // TODO find a way to remove QT signals and slots so this class does not use QT but still is able to
 // visualize the execution in viewer.
 signals:
@@ -31,7 +31,23 @@ int main(int argc, char** argv)
     else
       main_window->hide();
 
-    ServiceWorker service_worker(std::move(ifco_scene));
+    // a reachability map built by build_reachability_map for the kinematics file
+    std::string reachability_map_file;
+    std::shared_ptr<const ReachabilityMap> reachability_map;
+    n.param("reachability_map_file", reachability_map_file, std::string());
+    if (!reachability_map_file.empty())
+    {
+      try
+      {
+        reachability_map = ReachabilityMap::load(reachability_map_file);
+      }
+      catch (const std::runtime_error& e)
+      {
+        ROS_WARN_STREAM(e.what() << ", sampled poses are not filtered by reachability");
+      }
+    }
+
+    ServiceWorker service_worker(std::move(ifco_scene), reachability_map);
     QThread worker_thread;
     service_worker.moveToThread(&worker_thread);
     QObject::connect(&application, SIGNAL(lastWindowClosed()), &application, SLOT(quit()));
@@ -39,8 +55,14 @@ int main(int argc, char** argv)
 
     ros::ServiceServer checkKinematicsService = n.advertiseService("check_kinematics",
                                                     &ServiceWorker::checkKinematicsQuery, &service_worker);
+    ros::ServiceServer checkKinematicsBeliefService = n.advertiseService(
+        "check_kinematics_belief", &ServiceWorker::checkKinematicsBeliefQuery, &service_worker);
     ros::ServiceServer cerrtExampleService = n.advertiseService("cerrt_example",
         &ServiceWorker::cerrtExampleQuery, &service_worker);
+    ros::ServiceServer planCerrtService =
+        n.advertiseService("plan_cerrt", &ServiceWorker::planCerrtQuery, &service_worker);
+    ros::ServiceServer revalidateTrajectoryService =
+        n.advertiseService("revalidate_trajectory", &ServiceWorker::revalidateTrajectoryQuery, &service_worker);
 
     worker_thread.start();
     service_worker.start(20);
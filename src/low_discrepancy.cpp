@@ -0,0 +1,167 @@
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <stdexcept>
+#include "low_discrepancy.h"
+
+namespace
+{
+const unsigned primes[] = { 2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37, 41, 43, 47, 53 };
+
+std::size_t greatestCommonDivisor(std::size_t a, std::size_t b)
+{
+  while (b != 0)
+  {
+    auto remainder = a % b;
+    a = b;
+    b = remainder;
+  }
+
+  return a;
+}
+}
+
+UnitCubeSequence::~UnitCubeSequence()
+{
+}
+
+UniformSequence::UniformSequence(std::size_t dimensions, std::mt19937::result_type seed)
+  : UnitCubeSequence(dimensions), engine_(seed)
+{
+}
+
+void UniformSequence::next(double* point)
+{
+  std::uniform_real_distribution<double> random_01;
+  for (std::size_t i = 0; i < dimensions(); ++i)
+    point[i] = random_01(engine_);
+}
+
+ScrambledHaltonSequence::ScrambledHaltonSequence(std::size_t dimensions, std::mt19937::result_type seed)
+  : ScrambledHaltonSequence(std::vector<bool>(dimensions, true), seed)
+{
+}
+
+ScrambledHaltonSequence::ScrambledHaltonSequence(const std::vector<bool>& active_dimensions,
+                                                 std::mt19937::result_type seed)
+  : UnitCubeSequence(active_dimensions.size())
+{
+  const std::size_t number_of_primes = sizeof(primes) / sizeof(primes[0]);
+  if (static_cast<std::size_t>(std::count(active_dimensions.begin(), active_dimensions.end(), true)) >
+      number_of_primes)
+    throw std::invalid_argument("At most " + std::to_string(number_of_primes) +
+                                " active dimensions are supported by the scrambled Halton sequence");
+
+  // the small bases are the most uniform ones, inactive dimensions must not use them up
+  std::mt19937 engine(seed);
+  std::uniform_real_distribution<double> random_01;
+  std::size_t next_prime = 0;
+  for (std::size_t i = 0; i < active_dimensions.size(); ++i)
+  {
+    unsigned base = active_dimensions[i] ? primes[next_prime++] : 0;
+    bases_.push_back(base);
+
+    // zero stays zero, so the trailing zero digits of an index do not add up
+    std::vector<unsigned> permutation(base);
+    std::iota(permutation.begin(), permutation.end(), 0);
+    if (base > 0)
+      std::shuffle(permutation.begin() + 1, permutation.end(), engine);
+    digit_permutations_.push_back(permutation);
+
+    shifts_.push_back(base > 0 ? random_01(engine) : 0);
+  }
+}
+
+void ScrambledHaltonSequence::next(double* point)
+{
+  for (std::size_t i = 0; i < dimensions(); ++i)
+  {
+    if (bases_[i] == 0)
+    {
+      point[i] = 0.5;
+      continue;
+    }
+
+    auto value = radicalInverse(i, index_) + shifts_[i];
+    point[i] = value - std::floor(value);
+  }
+
+  ++index_;
+}
+
+double ScrambledHaltonSequence::radicalInverse(std::size_t dimension, std::uint64_t index) const
+{
+  auto base = bases_[dimension];
+  auto& permutation = digit_permutations_[dimension];
+
+  double result = 0;
+  double digit_weight = 1.0 / base;
+  for (; index > 0; index /= base, digit_weight /= base)
+    result += permutation[index % base] * digit_weight;
+
+  return result;
+}
+
+StratifiedGridSequence::StratifiedGridSequence(const std::vector<bool>& active_dimensions, std::size_t count,
+                                               std::mt19937::result_type seed)
+  : UnitCubeSequence(active_dimensions.size())
+  , active_dimensions_(active_dimensions)
+  , cells_per_dimension_(active_dimensions.size(), 1)
+  , remainder_(active_dimensions, seed)
+{
+  // refine the active dimension with the fewest cells while the grid still fits into count
+  while (std::count(active_dimensions_.begin(), active_dimensions_.end(), true) > 0)
+  {
+    std::size_t coarsest = dimensions();
+    for (std::size_t i = 0; i < dimensions(); ++i)
+      if (active_dimensions_[i] &&
+          (coarsest == dimensions() || cells_per_dimension_[i] < cells_per_dimension_[coarsest]))
+        coarsest = i;
+
+    auto refined = number_of_cells_ / cells_per_dimension_[coarsest] * (cells_per_dimension_[coarsest] + 1);
+    if (refined > count)
+      break;
+
+    ++cells_per_dimension_[coarsest];
+    number_of_cells_ = refined;
+  }
+
+  // a stride near the golden ratio of the cells that is coprime to their number visits every cell once and puts
+  // consecutive cells far apart
+  stride_ = std::max<std::size_t>(1, static_cast<std::size_t>(std::round(number_of_cells_ * 0.6180339887)));
+  while (greatestCommonDivisor(stride_, number_of_cells_) != 1)
+    ++stride_;
+}
+
+void StratifiedGridSequence::next(double* point)
+{
+  if (next_cell_ >= number_of_cells_)
+  {
+    remainder_.next(point);
+    return;
+  }
+
+  // the digits of the cell in the mixed radix of the cells per dimension
+  auto cell = next_cell_ * stride_ % number_of_cells_;
+  for (std::size_t i = 0; i < dimensions(); ++i)
+  {
+    point[i] = (cell % cells_per_dimension_[i] + 0.5) / cells_per_dimension_[i];
+    cell /= cells_per_dimension_[i];
+  }
+
+  ++next_cell_;
+}
+
+std::unique_ptr<UnitCubeSequence> makeUnitCubeSequence(const std::string& mode,
+                                                       const std::vector<bool>& active_dimensions, std::size_t count,
+                                                       std::mt19937::result_type seed)
+{
+  if (mode == "uniform")
+    return std::unique_ptr<UnitCubeSequence>(new UniformSequence(active_dimensions.size(), seed));
+  if (mode == "halton")
+    return std::unique_ptr<UnitCubeSequence>(new ScrambledHaltonSequence(active_dimensions, seed));
+  if (mode == "grid")
+    return std::unique_ptr<UnitCubeSequence>(new StratifiedGridSequence(active_dimensions, count, seed));
+
+  throw std::invalid_argument("Unknown sampling mode: " + mode);
+}
@@ -0,0 +1,116 @@
+#ifndef LOW_DISCREPANCY_H
+#define LOW_DISCREPANCY_H
+
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+/* A sequence of points in the unit cube [0, 1)^dimensions, the source of the numbers WorkspaceSampler turns into
+ * poses.
+ */
+class UnitCubeSequence
+{
+public:
+  explicit UnitCubeSequence(std::size_t dimensions) : dimensions_(dimensions)
+  {
+  }
+
+  virtual ~UnitCubeSequence();
+
+  std::size_t dimensions() const
+  {
+    return dimensions_;
+  }
+
+  /* Write the next point to point, which must hold dimensions values. */
+  virtual void next(double* point) = 0;
+
+private:
+  std::size_t dimensions_;
+};
+
+/* Independent uniform points, as drawn with std::uniform_real_distribution. */
+class UniformSequence : public UnitCubeSequence
+{
+public:
+  UniformSequence(std::size_t dimensions, std::mt19937::result_type seed);
+
+  void next(double* point) override;
+
+private:
+  std::mt19937 engine_;
+};
+
+/* The Halton sequence, randomized with a random permutation of the non-zero digits per dimension and a random shift
+ * modulo 1 per dimension. The permutations break the correlation between dimensions of large prime bases, the shift
+ * makes differently seeded sequences independent. The active dimensions get the smallest primes as bases, in order,
+ * the inactive ones are 0.5. At most 16 active dimensions, more throw std::invalid_argument.
+ */
+class ScrambledHaltonSequence : public UnitCubeSequence
+{
+public:
+  /* A sequence with every dimension active. */
+  ScrambledHaltonSequence(std::size_t dimensions, std::mt19937::result_type seed);
+
+  ScrambledHaltonSequence(const std::vector<bool>& active_dimensions, std::mt19937::result_type seed);
+
+  void next(double* point) override;
+
+  /* The prime base of dimension, 0 for inactive dimensions. */
+  unsigned base(std::size_t dimension) const
+  {
+    return bases_[dimension];
+  }
+
+private:
+  double radicalInverse(std::size_t dimension, std::uint64_t index) const;
+
+  // 0 for inactive dimensions
+  std::vector<unsigned> bases_;
+  std::vector<std::vector<unsigned>> digit_permutations_;
+  std::vector<double> shifts_;
+  // the first point, index 0, is skipped
+  std::uint64_t index_ = 1;
+};
+
+/* A stratified grid for a known number of samples. The active dimensions are split into cells, as many as fit into
+ * count, with the dimensions split as evenly as possible. The centers of the cells are returned in an order that
+ * spreads consecutive points over the grid, inactive dimensions are 0.5. When the cells are used up the points come
+ * from a scrambled Halton sequence.
+ */
+class StratifiedGridSequence : public UnitCubeSequence
+{
+public:
+  StratifiedGridSequence(const std::vector<bool>& active_dimensions, std::size_t count,
+                         std::mt19937::result_type seed);
+
+  void next(double* point) override;
+
+  /* The number of cells of the grid, and the step between the cells of consecutive points, which is coprime to it. */
+  std::size_t numberOfCells() const
+  {
+    return number_of_cells_;
+  }
+
+  std::size_t stride() const
+  {
+    return stride_;
+  }
+
+private:
+  std::vector<bool> active_dimensions_;
+  std::vector<std::size_t> cells_per_dimension_;
+  std::size_t number_of_cells_ = 1;
+  std::size_t stride_ = 1;
+  std::size_t next_cell_ = 0;
+  ScrambledHaltonSequence remainder_;
+};
+
+/* The sequence of a sampling mode: "uniform", "halton" or "grid". Throws std::invalid_argument for other modes. */
+std::unique_ptr<UnitCubeSequence> makeUnitCubeSequence(const std::string& mode,
+                                                       const std::vector<bool>& active_dimensions, std::size_t count,
+                                                       std::mt19937::result_type seed);
+
+#endif  // LOW_DISCREPANCY_H
@@ -0,0 +1,123 @@
+#ifndef LRU_CACHE_H
+#define LRU_CACHE_H
+
+#include <functional>
+#include <list>
+#include <unordered_map>
+#include <utility>
+
+/* A cache of at most capacity values that evicts the least recently used value first. Lookups count hits and misses,
+ * a value that is found but no longer valid counts as a miss and is removed.
+ */
+template <class Key, class Value, class Hash = std::hash<Key>> class LruCache
+{
+public:
+  explicit LruCache(std::size_t capacity) : capacity_(capacity)
+  {
+  }
+
+  /* The value of key, which becomes the most recently used one, or nullptr if there is none or valid(value) is
+   * false. The pointer stays valid until the value is evicted or erased.
+   */
+  template <class Valid> Value* find(const Key& key, Valid valid)
+  {
+    auto entry = index_.find(key);
+    if (entry == index_.end())
+    {
+      ++misses_;
+      return nullptr;
+    }
+
+    if (!valid(entry->second->second))
+    {
+      ++misses_;
+      ++invalidations_;
+      entries_.erase(entry->second);
+      index_.erase(entry);
+      return nullptr;
+    }
+
+    ++hits_;
+    entries_.splice(entries_.begin(), entries_, entry->second);
+    return &entry->second->second;
+  }
+
+  Value* find(const Key& key)
+  {
+    return find(key, [](const Value&) { return true; });
+  }
+
+  /* Insert or replace the value of key as the most recently used one. */
+  void insert(const Key& key, Value value)
+  {
+    auto entry = index_.find(key);
+    if (entry != index_.end())
+    {
+      entry->second->second = std::move(value);
+      entries_.splice(entries_.begin(), entries_, entry->second);
+      return;
+    }
+
+    entries_.emplace_front(key, std::move(value));
+    index_[key] = entries_.begin();
+    evict();
+  }
+
+  void erase(const Key& key)
+  {
+    auto entry = index_.find(key);
+    if (entry == index_.end())
+      return;
+
+    entries_.erase(entry->second);
+    index_.erase(entry);
+  }
+
+  /* Change the capacity, evicting the least recently used values that do not fit anymore. */
+  void setCapacity(std::size_t capacity)
+  {
+    capacity_ = capacity;
+    evict();
+  }
+
+  std::size_t size() const
+  {
+    return entries_.size();
+  }
+
+  std::size_t hits() const
+  {
+    return hits_;
+  }
+
+  std::size_t misses() const
+  {
+    return misses_;
+  }
+
+  /* The number of misses caused by values that were found but not valid anymore. */
+  std::size_t invalidations() const
+  {
+    return invalidations_;
+  }
+
+private:
+  void evict()
+  {
+    while (entries_.size() > capacity_)
+    {
+      index_.erase(entries_.back().first);
+      entries_.pop_back();
+    }
+  }
+
+  std::size_t capacity_;
+  std::list<std::pair<Key, Value>> entries_;
+  std::unordered_map<Key, typename std::list<std::pair<Key, Value>>::iterator, Hash> index_;
+
+  std::size_t hits_ = 0;
+  std::size_t misses_ = 0;
+  std::size_t invalidations_ = 0;
+};
+
+#endif  // LRU_CACHE_H
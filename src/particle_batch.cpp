@@ -0,0 +1,57 @@
+#include "particle_batch.h"
+
+ParticleBatch::ParticleBatch(std::size_t dof, std::size_t size)
+{
+  resize(dof, size);
+}
+
+void ParticleBatch::resize(std::size_t dof, std::size_t size)
+{
+  dof_ = dof;
+  size_ = size;
+  configurations_.resize(dof * size);
+  errors_.resize(dof * size);
+  noise_.resize(dof * size);
+}
+
+void ParticleBatch::getConfiguration(std::size_t particle, rl::math::Vector& configuration) const
+{
+  configuration.resize(static_cast<int>(dof_));
+  for (std::size_t i = 0; i < dof_; ++i)
+    configuration(i) = configurations_[i * size_ + particle];
+}
+
+void ParticleBatch::step(const rl::math::Vector& target)
+{
+  for (std::size_t i = 0; i < dof_; ++i)
+  {
+    // the inner loops are written over restrict pointers so the compiler can turn them into SIMD lanes
+    rl::math::Real* __restrict__ configurations = &configurations_[i * size_];
+    rl::math::Real* __restrict__ errors = &errors_[i * size_];
+    const rl::math::Real* __restrict__ noise = &noise_[i * size_];
+    const rl::math::Real joint_target = target(i);
+
+    for (std::size_t k = 0; k < size_; ++k)
+    {
+      configurations[k] = joint_target + errors[k] + noise[k];
+      errors[k] += noise[k];
+    }
+  }
+}
+
+void ParticleBatch::checkJointLimits(const rl::math::Vector& minimum, const rl::math::Vector& maximum,
+                                     std::vector<unsigned char>& violations) const
+{
+  violations.assign(size_, 0);
+  unsigned char* __restrict__ violated = violations.data();
+
+  for (std::size_t i = 0; i < dof_; ++i)
+  {
+    const rl::math::Real* __restrict__ configurations = &configurations_[i * size_];
+    const rl::math::Real lower = minimum(i);
+    const rl::math::Real upper = maximum(i);
+
+    for (std::size_t k = 0; k < size_; ++k)
+      violated[k] |= static_cast<unsigned char>((configurations[k] < lower) | (configurations[k] > upper));
+  }
+}
@@ -0,0 +1,91 @@
+#ifndef PARTICLE_BATCH_H
+#define PARTICLE_BATCH_H
+
+#include <random>
+#include <vector>
+#include <rl/math/Vector.h>
+
+/* Configurations, accumulated errors and motion noise of a set of particles, stored as DOF x P arrays. The values of
+ * one joint for all particles are contiguous, so the per-step updates run as vectorized loops over the particles.
+ */
+class ParticleBatch
+{
+public:
+  ParticleBatch() = default;
+  ParticleBatch(std::size_t dof, std::size_t size);
+
+  /* Reshape to size particles of dof joints. The storage is kept when it shrinks, so a batch that is reused across
+   * propagations only allocates for the largest shape it has seen.
+   */
+  void resize(std::size_t dof, std::size_t size);
+
+  std::size_t dof() const
+  {
+    return dof_;
+  }
+
+  std::size_t size() const
+  {
+    return size_;
+  }
+
+  /* Copy the configuration of a particle to configuration. */
+  void getConfiguration(std::size_t particle, rl::math::Vector& configuration) const;
+
+  /* Place every particle around center with gaussian noise of std_error per joint. The noise becomes the accumulated
+   * error of the particle.
+   */
+  template <class RandomEngine>
+  void sampleInitial(const rl::math::Vector& center, const rl::math::Vector& std_error, RandomEngine& engine)
+  {
+    sampleNoise(std_error, engine);
+    for (std::size_t i = 0; i < dof_; ++i)
+      for (std::size_t k = 0; k < size_; ++k)
+      {
+        errors_[i * size_ + k] = noise_[i * size_ + k];
+        configurations_[i * size_ + k] = center(i) + noise_[i * size_ + k];
+      }
+  }
+
+  /* Sample the motion noise of the next step, gaussian with std_error per joint. */
+  template <class RandomEngine> void sampleNoise(const rl::math::Vector& std_error, RandomEngine& engine)
+  {
+    std::normal_distribution<rl::math::Real> gaussian;
+    for (std::size_t i = 0; i < dof_; ++i)
+      for (std::size_t k = 0; k < size_; ++k)
+        noise_[i * size_ + k] = std_error(i) * gaussian(engine);
+  }
+
+  /* Sample the motion noise of the next step for the particles k with finished[k] zero only, the others do not move
+   * anymore and get no noise.
+   */
+  template <class RandomEngine>
+  void sampleNoise(const rl::math::Vector& std_error, const std::vector<unsigned char>& finished, RandomEngine& engine)
+  {
+    std::normal_distribution<rl::math::Real> gaussian;
+    for (std::size_t i = 0; i < dof_; ++i)
+      for (std::size_t k = 0; k < size_; ++k)
+        noise_[i * size_ + k] = finished[k] ? 0 : std_error(i) * gaussian(engine);
+  }
+
+  /* Move every particle to target plus its accumulated error plus the sampled motion noise, then accumulate the
+   * noise into the error.
+   */
+  void step(const rl::math::Vector& target);
+
+  /* Set violations[k] to a non-zero value if particle k is outside of [minimum, maximum] in any joint, and to zero
+   * otherwise.
+   */
+  void checkJointLimits(const rl::math::Vector& minimum, const rl::math::Vector& maximum,
+                        std::vector<unsigned char>& violations) const;
+
+private:
+  std::size_t dof_ = 0;
+  std::size_t size_ = 0;
+
+  std::vector<rl::math::Real> configurations_;
+  std::vector<rl::math::Real> errors_;
+  std::vector<rl::math::Real> noise_;
+};
+
+#endif  // PARTICLE_BATCH_H
@@ -0,0 +1,150 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "reachability_map.h"
+
+namespace
+{
+const char magic[8] = { 'R', 'E', 'A', 'C', 'H', 'M', 'A', 'P' };
+// version 2 marks the neighbours of reached bins, maps of version 1 have to be built again
+const std::uint32_t format_version = 2;
+
+/* The file starts with this header, followed by one byte per bin. */
+struct Header
+{
+  char magic[8];
+  std::uint32_t version;
+  std::uint32_t cells[3];
+  double origin[3];
+  double voxel_size;
+  std::uint32_t direction_bins;
+  std::uint32_t roll_bins;
+};
+
+std::uint32_t bin(double value_01, std::uint32_t bins)
+{
+  return std::min(bins - 1, static_cast<std::uint32_t>(std::max(0.0, value_01) * bins));
+}
+}
+
+constexpr std::size_t ReachabilityMap::Layout::outside;
+
+std::size_t ReachabilityMap::Layout::index(const rl::math::Transform& pose) const
+{
+  std::size_t voxel = 0;
+  for (int i = 2; i >= 0; --i)
+  {
+    auto cell = std::floor((pose.translation()(i) - origin(i)) / voxel_size);
+    if (cell < 0 || cell >= cells[i])
+      return outside;
+    voxel = voxel * cells[i] + static_cast<std::size_t>(cell);
+  }
+
+  // the face of the cube is the largest coordinate of the approach direction, the bins on it come from the two others
+  rl::math::Vector3 approach = pose.linear().col(2);
+  int major;
+  approach.cwiseAbs().maxCoeff(&major);
+  int face = 2 * major + (approach(major) < 0 ? 1 : 0);
+  auto u = approach((major + 1) % 3) / std::abs(approach(major));
+  auto v = approach((major + 2) % 3) / std::abs(approach(major));
+
+  // the roll is measured from the next axis after the major one, which is never parallel to the approach direction
+  rl::math::Vector3 reference = rl::math::Vector3::Unit((major + 1) % 3);
+  rl::math::Vector3 e1 = (reference - reference.dot(approach) * approach).normalized();
+  rl::math::Vector3 e2 = approach.cross(e1);
+  rl::math::Vector3 x_axis = pose.linear().col(0);
+  auto roll = std::atan2(x_axis.dot(e2), x_axis.dot(e1));
+
+  std::size_t orientation = face;
+  orientation = orientation * direction_bins + bin((u + 1) / 2, direction_bins);
+  orientation = orientation * direction_bins + bin((v + 1) / 2, direction_bins);
+  orientation = orientation * roll_bins + bin((roll + M_PI) / (2 * M_PI), roll_bins);
+
+  return voxel * orientations() + orientation;
+}
+
+ReachabilityMap::~ReachabilityMap()
+{
+  if (mapping_)
+    munmap(mapping_, mapping_size_);
+}
+
+std::shared_ptr<const ReachabilityMap> ReachabilityMap::load(const std::string& file_name)
+{
+  int file = open(file_name.c_str(), O_RDONLY);
+  if (file < 0)
+    throw std::runtime_error("Could not open the reachability map " + file_name);
+
+  struct stat file_status;
+  if (fstat(file, &file_status) != 0 || static_cast<std::size_t>(file_status.st_size) < sizeof(Header))
+  {
+    close(file);
+    throw std::runtime_error("The reachability map " + file_name + " is too short");
+  }
+
+  std::shared_ptr<ReachabilityMap> map(new ReachabilityMap);
+  map->mapping_size_ = file_status.st_size;
+  map->mapping_ = mmap(nullptr, map->mapping_size_, PROT_READ, MAP_SHARED, file, 0);
+  close(file);
+  if (map->mapping_ == MAP_FAILED)
+  {
+    map->mapping_ = nullptr;
+    throw std::runtime_error("Could not map the reachability map " + file_name);
+  }
+
+  Header header;
+  std::memcpy(&header, map->mapping_, sizeof(Header));
+  if (!std::equal(magic, magic + sizeof(magic), header.magic) || header.version != format_version)
+    throw std::runtime_error(file_name + " is not a reachability map of a supported version");
+
+  auto& layout = map->layout_;
+  std::copy(header.cells, header.cells + 3, layout.cells.begin());
+  layout.origin = rl::math::Vector3(header.origin[0], header.origin[1], header.origin[2]);
+  layout.voxel_size = header.voxel_size;
+  layout.direction_bins = header.direction_bins;
+  layout.roll_bins = header.roll_bins;
+  if (map->mapping_size_ != sizeof(Header) + layout.size())
+    throw std::runtime_error("The size of the reachability map " + file_name + " does not match its header");
+
+  map->capabilities_ = static_cast<const std::uint8_t*>(map->mapping_) + sizeof(Header);
+  return map;
+}
+
+void ReachabilityMap::save(const std::string& file_name, const Layout& layout,
+                           const std::vector<std::uint8_t>& capabilities)
+{
+  if (capabilities.size() != layout.size())
+    throw std::runtime_error("The number of capabilities does not match the layout of the reachability map");
+
+  Header header;
+  std::memset(&header, 0, sizeof(Header));
+  std::copy(magic, magic + sizeof(magic), header.magic);
+  header.version = format_version;
+  std::copy(layout.cells.begin(), layout.cells.end(), header.cells);
+  for (int i = 0; i < 3; ++i)
+    header.origin[i] = layout.origin(i);
+  header.voxel_size = layout.voxel_size;
+  header.direction_bins = layout.direction_bins;
+  header.roll_bins = layout.roll_bins;
+
+  std::ofstream file(file_name, std::ios::binary | std::ios::trunc);
+  file.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+  file.write(reinterpret_cast<const char*>(capabilities.data()), capabilities.size());
+  if (!file)
+    throw std::runtime_error("Could not write the reachability map " + file_name);
+}
+
+ReachabilityChecker::~ReachabilityChecker()
+{
+}
+
+bool ReachabilityChecker::contains(const rl::math::Transform& transform) const
+{
+  return map_->capability(transform) >= minimum_capability_;
+}
@@ -0,0 +1,102 @@
+#ifndef REACHABILITY_MAP_H
+#define REACHABILITY_MAP_H
+
+#include <array>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+#include <rl/math/Transform.h>
+#include <rl/math/Vector.h>
+#include "workspace_checkers.h"
+
+/* How well the end effector can reach poses, for voxels of positions times bins of orientations. Built offline by
+ * build_reachability_map and memory mapped read-only when loaded, so loading is immediate and the map is shared by
+ * all processes that use it.
+ *
+ * An orientation is binned by the direction of its z axis, the approach direction, on the faces of a cube with
+ * direction_bins x direction_bins bins per face, and by the angle of its x axis around the approach direction in
+ * roll_bins bins. The capability of a bin is 0 if no pose in it or in a neighbouring bin was reached, 1 to 255 growing
+ * with the number of reached poses if poses in it were reached, and 1 if only poses in a neighbouring bin were.
+ */
+class ReachabilityMap
+{
+public:
+  struct Layout
+  {
+    std::array<std::uint32_t, 3> cells;
+    rl::math::Vector3 origin;
+    double voxel_size;
+    std::uint32_t direction_bins;
+    std::uint32_t roll_bins;
+
+    /* The number of orientation bins per voxel. */
+    std::size_t orientations() const
+    {
+      return 6 * direction_bins * direction_bins * roll_bins;
+    }
+
+    /* The number of bins of the map. */
+    std::size_t size() const
+    {
+      return static_cast<std::size_t>(cells[0]) * cells[1] * cells[2] * orientations();
+    }
+
+    /* The bin of a pose, or outside if its position is not within the voxels. */
+    std::size_t index(const rl::math::Transform& pose) const;
+
+    static constexpr std::size_t outside = std::numeric_limits<std::size_t>::max();
+  };
+
+  ~ReachabilityMap();
+
+  ReachabilityMap(const ReachabilityMap&) = delete;
+  ReachabilityMap& operator=(const ReachabilityMap&) = delete;
+
+  /* Map a file written by save. Throws std::runtime_error if it cannot be mapped or is not a reachability map. */
+  static std::shared_ptr<const ReachabilityMap> load(const std::string& file_name);
+
+  /* Write capabilities, one per bin of layout. Throws std::runtime_error if the file cannot be written. */
+  static void save(const std::string& file_name, const Layout& layout, const std::vector<std::uint8_t>& capabilities);
+
+  /* The capability of the bin of a pose, 0 for poses outside of the voxels. */
+  std::uint8_t capability(const rl::math::Transform& pose) const
+  {
+    auto i = layout_.index(pose);
+    return i == Layout::outside ? 0 : capabilities_[i];
+  }
+
+  const Layout& layout() const
+  {
+    return layout_;
+  }
+
+private:
+  ReachabilityMap() = default;
+
+  Layout layout_;
+  void* mapping_ = nullptr;
+  std::size_t mapping_size_ = 0;
+  const std::uint8_t* capabilities_ = nullptr;
+};
+
+/* The poses whose bin in a reachability map has at least a minimum capability. */
+class ReachabilityChecker : public WorkspaceChecker
+{
+public:
+  ReachabilityChecker(std::shared_ptr<const ReachabilityMap> map, std::uint8_t minimum_capability = 1)
+    : map_(map), minimum_capability_(minimum_capability)
+  {
+  }
+
+  ~ReachabilityChecker() override;
+
+  bool contains(const rl::math::Transform& transform) const override;
+
+private:
+  std::shared_ptr<const ReachabilityMap> map_;
+  std::uint8_t minimum_capability_;
+};
+
+#endif  // REACHABILITY_MAP_H
@@ -0,0 +1,209 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <rl/sg/Body.h>
+#include <rl/sg/Model.h>
+#include <rl/sg/Shape.h>
+#include "self_collision_mask.h"
+
+std::vector<BodySphere> robotBodySpheres(const rl::kin::Kinematics& kinematics, rl::sg::bullet::Scene& scene)
+{
+  auto robot = scene.getModel(0);
+  std::vector<BodySphere> result(std::min(kinematics.getBodies(), robot->getNumBodies()),
+                                 BodySphere{ rl::math::Vector3::Zero(), 0 });
+
+  // the bullet shapes of rl keep their rl::sg::Shape as the user pointer of their collision objects
+  std::unordered_map<const rl::sg::Shape*, const btCollisionObject*> shape_objects;
+  auto& objects = scene.world->getCollisionObjectArray();
+  for (int i = 0; i < objects.size(); ++i)
+    shape_objects[static_cast<const rl::sg::Shape*>(objects[i]->getUserPointer())] = objects[i];
+
+  for (std::size_t b = 0; b < result.size(); ++b)
+  {
+    std::vector<BodySphere> shape_spheres;
+    for (std::size_t s = 0; s < robot->getBody(b)->getNumShapes(); ++s)
+    {
+      auto shape = robot->getBody(b)->getShape(s);
+      auto object = shape_objects.find(shape);
+      if (object == shape_objects.end())
+        continue;
+
+      btVector3 center;
+      btScalar radius;
+      object->second->getCollisionShape()->getBoundingSphere(center, radius);
+
+      rl::math::Transform transform;
+      shape->getTransform(transform);
+      shape_spheres.push_back({ transform * rl::math::Vector3(center.x(), center.y(), center.z()), radius });
+    }
+
+    if (shape_spheres.empty())
+      continue;
+
+    rl::math::Vector3 minimum = shape_spheres[0].center;
+    rl::math::Vector3 maximum = shape_spheres[0].center;
+    for (auto& sphere : shape_spheres)
+    {
+      minimum = minimum.cwiseMin(sphere.center - rl::math::Vector3::Constant(sphere.radius));
+      maximum = maximum.cwiseMax(sphere.center + rl::math::Vector3::Constant(sphere.radius));
+    }
+
+    result[b].center = (minimum + maximum) / 2;
+    for (auto& sphere : shape_spheres)
+      result[b].radius = std::max(result[b].radius, (sphere.center - result[b].center).norm() + sphere.radius);
+  }
+
+  return result;
+}
+
+rl::math::Real robotLinkReach(const rl::kin::Kinematics& kinematics, rl::sg::bullet::Scene& scene)
+{
+  rl::math::Real result = 0;
+  for (auto& sphere : robotBodySpheres(kinematics, scene))
+    result = std::max(result, sphere.center.norm() + sphere.radius);
+  return result;
+}
+
+std::shared_ptr<SelfCollisionMask> SelfCollisionMask::build(rl::kin::Kinematics& kinematics,
+                                                            rl::sg::bullet::Scene& scene)
+{
+  auto robot = scene.getModel(0);
+  auto result = std::make_shared<SelfCollisionMask>();
+  result->bodies_ = std::min(kinematics.getBodies(), robot->getNumBodies());
+  result->pairs_.assign(result->bodies_ * result->bodies_, false);
+  result->world_.assign(result->bodies_, false);
+
+  std::vector<std::pair<std::size_t, std::size_t>> candidates;
+  for (std::size_t i = 0; i < result->bodies_; ++i)
+  {
+    result->world_[i] = !kinematics.isColliding(i);
+    for (std::size_t j = i + 1; j < result->bodies_; ++j)
+    {
+      if (kinematics.isColliding(i, j))
+      {
+        candidates.push_back({ i, j });
+      }
+      else
+      {
+        result->mask(i, j);
+        ++result->ignored_pairs_;
+      }
+    }
+  }
+
+  auto spheres = robotBodySpheres(kinematics, scene);
+
+  // the distances between consecutive frame origins do not change with revolute joints. A distance that is not the
+  // same at the limits and in the middle of the joint ranges, e.g. across a prismatic joint or between branches of the
+  // tree, is not bounded and no pair across it is proven apart
+  rl::math::Vector minimum, maximum;
+  kinematics.getMinimum(minimum);
+  kinematics.getMaximum(maximum);
+
+  const rl::math::Real unbounded = std::numeric_limits<rl::math::Real>::infinity();
+  std::vector<rl::math::Vector> configurations = { minimum, maximum, (minimum + maximum) / 2 };
+  std::vector<rl::math::Real> links(result->bodies_, 0);
+  for (std::size_t c = 0; c < configurations.size(); ++c)
+  {
+    kinematics.setPosition(configurations[c]);
+    kinematics.updateFrames();
+    for (std::size_t b = 1; b < result->bodies_; ++b)
+    {
+      auto link = (kinematics.getFrame(b).translation() - kinematics.getFrame(b - 1).translation()).norm();
+      if (c == 0)
+        links[b] = link;
+      else if (std::abs(link - links[b]) > rigid_link_tolerance)
+        links[b] = unbounded;
+    }
+  }
+
+  // the sphere of body j stays within the links of the chain from the origin of frame i, whose distance from the
+  // sphere of body i is fixed, and the other way round
+  for (auto& pair : candidates)
+  {
+    rl::math::Real chain = 0;
+    for (std::size_t k = pair.first + 1; k <= pair.second; ++k)
+      chain += links[k];
+
+    auto& sphere_i = spheres[pair.first];
+    auto& sphere_j = spheres[pair.second];
+    auto apart = std::abs(sphere_i.center.norm() - sphere_j.center.norm()) - chain - sphere_i.radius - sphere_j.radius;
+    if (apart > gContactBreakingThreshold)
+    {
+      result->mask(pair.first, pair.second);
+      ++result->unreachable_pairs_;
+    }
+  }
+
+  return result;
+}
+
+void SelfCollisionMask::mask(std::size_t i, std::size_t j)
+{
+  pairs_[i * bodies_ + j] = true;
+  pairs_[j * bodies_ + i] = true;
+}
+
+SelfCollisionFilter::SelfCollisionFilter(std::shared_ptr<rl::sg::bullet::Scene> scene,
+                                         std::shared_ptr<const SelfCollisionMask> mask)
+  : scene_(scene), mask_(mask)
+{
+  // the bullet shapes of rl keep their rl::sg::Shape as the user pointer of their collision objects
+  auto robot = scene_->getModel(0);
+  std::unordered_map<const rl::sg::Shape*, int> shape_bodies;
+  for (std::size_t b = 0; b < mask_->bodies(); ++b)
+    for (std::size_t s = 0; s < robot->getBody(b)->getNumShapes(); ++s)
+      shape_bodies[robot->getBody(b)->getShape(s)] = static_cast<int>(b);
+
+  auto& objects = scene_->world->getCollisionObjectArray();
+  for (int i = 0; i < objects.size(); ++i)
+  {
+    auto body = shape_bodies.find(static_cast<const rl::sg::Shape*>(objects[i]->getUserPointer()));
+    if (body != shape_bodies.end())
+      robot_bodies_[objects[i]] = body->second;
+  }
+
+  auto pair_cache = scene_->world->getPairCache();
+  pair_cache->setOverlapFilterCallback(this);
+
+  std::vector<std::pair<btBroadphaseProxy*, btBroadphaseProxy*>> masked_pairs;
+  auto& pairs = pair_cache->getOverlappingPairArray();
+  for (int i = 0; i < pairs.size(); ++i)
+  {
+    if (!needBroadphaseCollision(pairs[i].m_pProxy0, pairs[i].m_pProxy1))
+      masked_pairs.push_back({ pairs[i].m_pProxy0, pairs[i].m_pProxy1 });
+  }
+
+  for (auto& pair : masked_pairs)
+    pair_cache->removeOverlappingPair(pair.first, pair.second, scene_->world->getDispatcher());
+}
+
+SelfCollisionFilter::~SelfCollisionFilter()
+{
+  scene_->world->getPairCache()->setOverlapFilterCallback(nullptr);
+}
+
+bool SelfCollisionFilter::needBroadphaseCollision(btBroadphaseProxy* proxy0, btBroadphaseProxy* proxy1) const
+{
+  // the test of bullet without a filter
+  if (!(proxy0->m_collisionFilterGroup & proxy1->m_collisionFilterMask) ||
+      !(proxy1->m_collisionFilterGroup & proxy0->m_collisionFilterMask))
+    return false;
+
+  int body0 = bodyOf(proxy0);
+  int body1 = bodyOf(proxy1);
+  if (body0 >= 0 && body1 >= 0)
+    return !mask_->isMasked(body0, body1);
+  if (body0 >= 0)
+    return !mask_->isMaskedFromWorld(body0);
+  if (body1 >= 0)
+    return !mask_->isMaskedFromWorld(body1);
+
+  return true;
+}
+
+int SelfCollisionFilter::bodyOf(const btBroadphaseProxy* proxy) const
+{
+  auto body = robot_bodies_.find(static_cast<const btCollisionObject*>(proxy->m_clientObject));
+  return body == robot_bodies_.end() ? -1 : body->second;
+}
@@ -0,0 +1,105 @@
+#ifndef SELF_COLLISION_MASK_H
+#define SELF_COLLISION_MASK_H
+
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include <btBulletCollisionCommon.h>
+#include <rl/kin/Kinematics.h>
+#include <rl/sg/bullet/Scene.h>
+
+/* The bounding sphere of a body of the robot in the frame of the body. */
+struct BodySphere
+{
+  rl::math::Vector3 center;
+  rl::math::Real radius;
+};
+
+/* The bounding spheres of the bodies of the robot model, the first model of scene, from the bounding spheres of their
+ * bullet shapes. A body without shapes gets an empty sphere at its origin.
+ */
+std::vector<BodySphere> robotBodySpheres(const rl::kin::Kinematics& kinematics, rl::sg::bullet::Scene& scene);
+
+/* The largest distance of any point of a robot body from the origin of its frame. */
+rl::math::Real robotLinkReach(const rl::kin::Kinematics& kinematics, rl::sg::bullet::Scene& scene);
+
+/* The pairs of robot links the bullet scene does not need to consider, by body index of the robot model, which is the
+ * first model of the scene. The ignore lists of the kinematics give the pairs of neighbouring links and the links that
+ * ignore the world. The other pairs are only masked if they are proven apart in every configuration: the bounding
+ * sphere of a link is at a fixed distance from the origin of its frame, and the origins of the frames of two links are
+ * at most the sum of the lengths of the links between them apart. A revolute joint does not change the length of a
+ * link, the lengths are compared at the limits and in the middle of the joint ranges and a length that changes, as
+ * with a prismatic joint, is taken as unbounded.
+ */
+class SelfCollisionMask
+{
+public:
+  /* The kinematics is left in the middle of the joint ranges. */
+  static std::shared_ptr<SelfCollisionMask> build(rl::kin::Kinematics& kinematics, rl::sg::bullet::Scene& scene);
+
+  std::size_t bodies() const
+  {
+    return bodies_;
+  }
+
+  bool isMasked(std::size_t i, std::size_t j) const
+  {
+    return pairs_[i * bodies_ + j];
+  }
+
+  /* Whether body i ignores everything outside the robot. */
+  bool isMaskedFromWorld(std::size_t i) const
+  {
+    return world_[i];
+  }
+
+  /* The number of pairs masked by the ignore lists and of the pairs proven apart. */
+  std::size_t ignoredPairs() const
+  {
+    return ignored_pairs_;
+  }
+
+  std::size_t unreachablePairs() const
+  {
+    return unreachable_pairs_;
+  }
+
+private:
+  void mask(std::size_t i, std::size_t j);
+
+  // the length of a link may differ this much between configurations from rounding alone
+  static constexpr rl::math::Real rigid_link_tolerance = 1.0e-9;
+
+  std::size_t bodies_ = 0;
+  std::vector<bool> pairs_;
+  std::vector<bool> world_;
+  std::size_t ignored_pairs_ = 0;
+  std::size_t unreachable_pairs_ = 0;
+};
+
+/* Installs a mask as the overlap filter of the pair cache of a bullet scene, so the broad phase never creates the
+ * masked pairs and the narrow phase never sees them. The pairs that already exist are removed.
+ */
+class SelfCollisionFilter : public btOverlapFilterCallback
+{
+public:
+  SelfCollisionFilter(std::shared_ptr<rl::sg::bullet::Scene> scene, std::shared_ptr<const SelfCollisionMask> mask);
+
+  /* Removes the filter from the pair cache. */
+  ~SelfCollisionFilter() override;
+
+  SelfCollisionFilter(const SelfCollisionFilter&) = delete;
+  SelfCollisionFilter& operator=(const SelfCollisionFilter&) = delete;
+
+  bool needBroadphaseCollision(btBroadphaseProxy* proxy0, btBroadphaseProxy* proxy1) const override;
+
+private:
+  /* The robot body of the object of proxy, -1 for the objects outside the robot. */
+  int bodyOf(const btBroadphaseProxy* proxy) const;
+
+  std::shared_ptr<rl::sg::bullet::Scene> scene_;
+  std::shared_ptr<const SelfCollisionMask> mask_;
+  std::unordered_map<const btCollisionObject*, int> robot_bodies_;
+};
+
+#endif  // SELF_COLLISION_MASK_H
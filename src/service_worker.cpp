@@ -25,11 +25,19 @@
 //
 
 #include <QMutexLocker>
+#include <boost/functional/hash.hpp>
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+#include <thread>
 #include "service_worker.h"
 #include "jacobian_controller.h"
 #include "workspace_samplers.h"
+#include "candidate_scoring.h"
 #include "utilities.h"
 #include "soma_cerrt.h"
+#include "self_collision_mask.h"
 
 void ServiceWorker::spinOnce()
 {
@@ -48,54 +56,136 @@ void ServiceWorker::start(unsigned rate)
   loop_timer.start();
 }
 
+namespace
+{
+std::int64_t quantize(double value, double resolution)
+{
+  return std::llround(value / resolution);
+}
+}  // namespace
+
 bool ServiceWorker::checkKinematicsQuery(kinematics_check::CheckKinematics::Request& req,
                                          kinematics_check::CheckKinematics::Response& res)
 {
-  const double delta = 0.017;
-  const unsigned maximum_steps = 1000;
-
   ROS_INFO("Receiving query");
   if (!checkParameters(req))
     return false;
 
-  // Create a frame from the position/quaternion data
-  Eigen::Affine3d ifco_transform;
-  Eigen::Affine3d goal_transform;
-  tf::poseMsgToEigen(req.ifco_pose, ifco_transform);
-  tf::poseMsgToEigen(req.goal_pose, goal_transform);
-  auto initial_configuration = utilities::stdToEigen(req.initial_configuration);
-
-  WorldCollisionTypes::PartToCollisionType part_to_type;
-  for (auto& allowed_collision_msg : req.allowed_collisions)
+  // the statistics are cumulative over all queries, they are only of interest when tuning the culling
+  if (auto culling = ifco_scene->getCollisionCulling())
   {
-    auto object_name = allowed_collision_msg.type == allowed_collision_msg.BOUNDING_BOX ?
-                           getBoxShapeName(allowed_collision_msg.box_id) :
-                           allowed_collision_msg.constraint_name;
-    CollisionType type;
+    std::ostringstream by_test;
+    for (std::size_t i = 0; i < culling->numTests(); ++i)
+      by_test << (i ? ", " : "") << culling->culledPairs(i);
+    ROS_DEBUG_STREAM("Collision culling so far: " << culling->culledPairs() << " of " << culling->testedPairs()
+                                                  << " pairs decided before the narrow phase (" << by_test.str()
+                                                  << " by test)");
 
-    type.terminating = allowed_collision_msg.terminate_on_collision;
-    type.required = allowed_collision_msg.required_collision;
-    type.ignored = allowed_collision_msg.ignored_collision;
+    // a rough upper estimate of the saving, the culled pairs are farther apart and cheaper for bullet than the average
+    // pair that went to the narrow phase
+    auto narrow_phase_pairs = culling->testedPairs() - culling->culledPairs();
+    if (narrow_phase_pairs > 0)
+    {
+      double saved = culling->narrowPhaseSeconds() / narrow_phase_pairs * culling->culledPairs();
+      ROS_DEBUG_STREAM("Collision culling took " << culling->testSeconds() << " s in the tests and "
+                                                 << culling->narrowPhaseSeconds() << " s in the narrow phase, it saved "
+                                                 << "at most about " << saved << " s");
+    }
+  }
 
-    part_to_type.insert({ object_name, type });
+  // identical or nearly identical requests are answered from the cache, unless a box near the trajectory changed
+  ros::NodeHandle n;
+  int cache_size;
+  double position_resolution, angle_resolution;
+  n.param("result_cache_size", cache_size, 256);
+  n.param("result_cache_position_resolution", position_resolution, 1.0e-3);
+  n.param("result_cache_angle_resolution", angle_resolution, 1.0e-3);
+  check_kinematics_cache.setCapacity(std::max(cache_size, 0));
+  auto parameters = CheckKinematicsParameters::read();
+  if (cache_size <= 0 || position_resolution <= 0 || angle_resolution <= 0)
+    return checkKinematicsRollouts(req, res, parameters);
+
+  auto key = getCacheKey(req, parameters, position_resolution, angle_resolution);
+  auto boxes = getBoxes(req.bounding_boxes_with_poses);
+  auto cached = check_kinematics_cache.find(
+      key, [this, &boxes](const CheckKinematicsCacheEntry& entry) { return isValid(entry, boxes); });
+  if (cached)
+  {
+    res = cached->response;
+    ROS_INFO_STREAM("Answered from the result cache, " << check_kinematics_cache.hits() << " hits and "
+                                                       << check_kinematics_cache.misses() << " misses so far");
+    return true;
   }
-  WorldCollisionTypes world_collision_types(part_to_type);
 
-  ROS_INFO("Setting ifco pose and creating bounding boxes");
-  ifco_scene->moveIfco(ifco_transform);
-  ifco_scene->removeBoxes();
-  for (std::size_t i = 0; i < req.bounding_boxes_with_poses.size(); ++i)
+  if (!checkKinematicsRollouts(req, res, parameters))
+    return false;
+
+  if (!res.success)
+    return true;
+
+  CheckKinematicsCacheEntry entry;
+  entry.response = res;
+  entry.boxes = boxes;
+
+  auto dof = req.initial_configuration.size();
+  auto kinematics = ifco_scene->getKinematics();
+  auto link_reach = robotLinkReach(*kinematics, *ifco_scene->getBulletScene());
+  for (std::size_t i = 0; i + dof <= res.trajectory.size(); i += dof)
   {
-    Eigen::Affine3d box_transform;
-    tf::poseMsgToEigen(req.bounding_boxes_with_poses[i].pose, box_transform);
-    ifco_scene->createBox(req.bounding_boxes_with_poses[i].box.dimensions, box_transform, getBoxName(i));
+    kinematics->setPosition(utilities::stdToEigen(
+        std::vector<double>(res.trajectory.begin() + i, res.trajectory.begin() + i + dof)));
+    kinematics->updateFrames();
+    entry.trajectory_bounds.extend(Aabb::ofFrames(*kinematics, link_reach));
   }
 
+  check_kinematics_cache.insert(key, entry);
+  ROS_INFO_STREAM("Result cache: " << check_kinematics_cache.hits() << " hits, " << check_kinematics_cache.misses()
+                                   << " misses, " << check_kinematics_cache.invalidations() << " invalidations");
+  return true;
+}
+
+ServiceWorker::CheckKinematicsParameters ServiceWorker::CheckKinematicsParameters::read()
+{
+  ros::NodeHandle n;
+  CheckKinematicsParameters parameters;
+  n.param("sample_count", parameters.sample_count, 20);
+  n.param("sampling_mode", parameters.sampling_mode, std::string("halton"));
+  n.param("candidate_pool_factor", parameters.candidate_pool_factor, 4);
+  n.param("candidate_distance_weight", parameters.candidate_weights.distance, 1.0);
+  n.param("candidate_manipulability_weight", parameters.candidate_weights.manipulability, 1.0);
+  n.param("candidate_clearance_weight", parameters.candidate_weights.clearance, 1.0);
+  n.param("approach_roadmap_seeds", parameters.approach_roadmap_seeds, 3);
+  n.param("reuse_rollout_prefixes", parameters.reuse_rollout_prefixes, true);
+
+  parameters.sample_count = std::max(parameters.sample_count, 0);
+  parameters.candidate_pool_factor = std::max(parameters.candidate_pool_factor, 1);
+  parameters.approach_roadmap_seeds = std::max(parameters.approach_roadmap_seeds, 0);
+  return parameters;
+}
+
+bool ServiceWorker::checkKinematicsRollouts(kinematics_check::CheckKinematics::Request& req,
+                                            kinematics_check::CheckKinematics::Response& res,
+                                            const CheckKinematicsParameters& parameters)
+{
+  const double delta = 0.017;
+  const unsigned maximum_steps = 1000;
+
+  // Create a frame from the position/quaternion data
+  Eigen::Affine3d goal_transform;
+  tf::poseMsgToEigen(req.goal_pose, goal_transform);
+  auto initial_configuration = utilities::stdToEigen(req.initial_configuration);
+
+  auto world_collision_types = makeCollisionTypes(req.allowed_collisions);
+  setupScene(req);
+
   ROS_INFO("Trying to plan to the goal frame");
   JacobianController jacobian_controller(ifco_scene->getKinematics(), ifco_scene->getBulletScene(), delta,
                                          maximum_steps, ifco_scene->getViewer());
   int status = 0;
-  auto result = jacobian_controller.moveSingleParticle(initial_configuration, goal_transform, world_collision_types);
+  // the checked steps of this rollout are kept for the rollouts to the sampled poses near the goal frame
+  JacobianController::RolloutTree rollout_tree;
+  auto result = jacobian_controller.moveSingleParticle(initial_configuration, goal_transform, world_collision_types,
+                                                       rollout_tree);
 
   if (result)
   {
@@ -108,52 +198,110 @@ bool ServiceWorker::checkKinematicsQuery(kinematics_check::CheckKinematics::Requ
 
   ROS_INFO_STREAM("Goal frame failures: " << result.description());
 
-  std::array<std::uniform_real_distribution<double>, 3> coordinate_distributions = {
-    std::uniform_real_distribution<double>(req.min_position_deltas[0], req.max_position_deltas[0]),
-    std::uniform_real_distribution<double>(req.min_position_deltas[1], req.max_position_deltas[1]),
-    std::uniform_real_distribution<double>(req.min_position_deltas[2], req.max_position_deltas[2])
-  };
+  Eigen::Affine3d ifco_transform;
+  tf::poseMsgToEigen(req.ifco_pose, ifco_transform);
+  auto approach_trajectory = approachThroughRoadmap(jacobian_controller, ifco_transform, initial_configuration,
+                                                    goal_transform, world_collision_types,
+                                                    parameters.approach_roadmap_seeds);
+  if (approach_trajectory)
+  {
+    res.success = true;
+    res.status = 3;
+    res.final_configuration = utilities::eigenToStd(approach_trajectory->back());
+    res.trajectory = utilities::concatanateEigneToStd(*approach_trajectory, res.final_configuration.size());
+    return true;
+  }
 
-  std::array<std::uniform_real_distribution<double>, 3> angle_distributions = {
-    std::uniform_real_distribution<double>(req.min_orientation_deltas[0], req.max_orientation_deltas[0]),
-    std::uniform_real_distribution<double>(req.min_orientation_deltas[1], req.max_orientation_deltas[1]),
-    std::uniform_real_distribution<double>(req.min_orientation_deltas[2], req.max_orientation_deltas[2])
-  };
+  std::array<double, 3> min_position_deltas, max_position_deltas, min_orientation_deltas, max_orientation_deltas;
+  std::vector<bool> active_dimensions(6);
+  for (std::size_t i = 0; i < 3; ++i)
+  {
+    min_position_deltas[i] = req.min_position_deltas[i];
+    max_position_deltas[i] = req.max_position_deltas[i];
+    min_orientation_deltas[i] = req.min_orientation_deltas[i];
+    max_orientation_deltas[i] = req.max_orientation_deltas[i];
+    active_dimensions[i] = min_position_deltas[i] < max_position_deltas[i];
+    active_dimensions[i + 3] = min_orientation_deltas[i] < max_orientation_deltas[i];
+  }
+  DeltaBoxSampler delta_sampler(goal_transform, min_position_deltas, max_position_deltas, min_orientation_deltas,
+                                max_orientation_deltas);
 
-  std::mt19937 generator(time(nullptr));
+  const unsigned sample_count = parameters.sample_count;
+  auto& sampling_mode = parameters.sampling_mode;
 
-  int sample_count;
-  ros::NodeHandle n;
-  n.param("sample_count", sample_count, 20);
+  // the rollouts are the expensive part, so more candidates than rollouts are drawn and only the most promising ones
+  // are rolled out
+  const unsigned pool_size = parameters.candidate_pool_factor * sample_count;
 
-  ROS_INFO("Beginning to sample within acceptable deltas");
-  for (unsigned i = 0; i < sample_count; ++i)
+  std::unique_ptr<UnitCubeSequence> sequence;
+  try
   {
-    rl::math::Vector3 sampled_point;
-    std::array<double, 3> sampled_rotation;
+    sequence = makeUnitCubeSequence(sampling_mode, active_dimensions, pool_size, time(nullptr));
+  }
+  catch (const std::invalid_argument& e)
+  {
+    ROS_ERROR_STREAM(e.what() << ", the sampling_mode must be uniform, halton or grid");
+    return false;
+  }
 
-    for (unsigned i = 0; i < 3; ++i)
-    {
-      sampled_point(i) = coordinate_distributions[i](generator);
-      sampled_rotation[i] = angle_distributions[i](generator);
-    }
+  // poses the reachability map rejects do not count as candidates, but at most this many poses are drawn in total
+  const unsigned maximum_draws = 10 * pool_size;
+  unsigned draws = 0;
+  unsigned unreachable = 0;
+
+  ROS_INFO_STREAM("Beginning to sample within acceptable deltas, sampling mode: " << sampling_mode);
+  std::vector<rl::math::Transform> candidates;
+  while (candidates.size() < pool_size && draws < maximum_draws)
+  {
+    auto sampled_transform = delta_sampler.generateFromSequence(*sequence);
+    ++draws;
+    if (reachability_map && reachability_map->capability(sampled_transform) == 0)
+      ++unreachable;
+    else
+      candidates.push_back(sampled_transform);
+  }
+
+  std::vector<CandidateScorer::Obstacle> obstacles;
+  for (std::size_t j = 0; j < req.bounding_boxes_with_poses.size(); ++j)
+  {
+    auto& box = req.bounding_boxes_with_poses[j];
+    if (box.box.dimensions.size() != 3 || !world_collision_types.getCollisionType("", getBoxShapeName(j)).prohibited)
+      continue;
 
-    rl::math::Transform sampled_transform;
-    sampled_transform.translation() = goal_transform.translation() + sampled_point;
-    sampled_transform.linear() = rl::math::AngleAxis(sampled_rotation[2], rl::math::Vector3::UnitZ()) *
-                                 rl::math::AngleAxis(sampled_rotation[1], rl::math::Vector3::UnitY()) *
-                                 rl::math::AngleAxis(sampled_rotation[0], rl::math::Vector3::UnitX()) *
-                                 goal_transform.linear();
+    CandidateScorer::Obstacle obstacle;
+    tf::poseMsgToEigen(box.pose, obstacle.pose);
+    obstacle.half_extents = rl::math::Vector3(box.box.dimensions[0], box.box.dimensions[1], box.box.dimensions[2]) / 2;
+    obstacles.push_back(obstacle);
+  }
+
+  CandidateScorer scorer(ifco_scene->getKinematics(), initial_configuration, obstacles, parameters.candidate_weights);
+  auto order = scorer.order(candidates);
+
+  ROS_INFO_STREAM("Rolling out the best " << std::min<std::size_t>(sample_count, candidates.size()) << " of "
+                                          << candidates.size() << " candidates");
+  unsigned i = 0;
+  for (; i < sample_count && i < order.size(); ++i)
+  {
+    auto& sampled_transform = candidates[order[i]];
 
+    auto orientation_deltas = delta_sampler.orientationDeltas(sampled_transform);
     ROS_INFO_STREAM("Trying to plan to the sampled frame number "
-                    << i << ". Translation sample: " << sampled_point.transpose() << ", rotation sample: "
-                    << sampled_rotation[0] << " " << sampled_rotation[1] << " " << sampled_rotation[2]);
-    auto result =
-        jacobian_controller.moveSingleParticle(initial_configuration, sampled_transform, world_collision_types);
+                    << i << " (candidate " << order[i] << "). Translation sample: "
+                    << (sampled_transform.translation() - goal_transform.translation()).transpose()
+                    << ", rotation sample: " << orientation_deltas[0] << " " << orientation_deltas[1] << " "
+                    << orientation_deltas[2]);
+    // the candidates are close to each other and to the goal frame, their rollouts continue from the checked steps of
+    // the earlier ones
+    auto result = parameters.reuse_rollout_prefixes ?
+                      jacobian_controller.moveSingleParticle(initial_configuration, sampled_transform,
+                                                             world_collision_types, rollout_tree) :
+                      jacobian_controller.moveSingleParticle(initial_configuration, sampled_transform,
+                                                             world_collision_types);
 
     if (result)
     {
-      ROS_INFO_STREAM("Success: " << result.description());
+      ROS_INFO_STREAM("Success after " << i + 1 << " attempts, " << rollout_tree.reusedSteps()
+                                       << " steps were reused: " << result.description());
       // TODO remove success as a returen
       res.success = true;
       res.status = 2;
@@ -161,16 +309,144 @@ bool ServiceWorker::checkKinematicsQuery(kinematics_check::CheckKinematics::Requ
       res.trajectory = utilities::concatanateEigneToStd(result.trajectory, res.final_configuration.size());
       return true;
     }
-    else
-      ROS_INFO_STREAM("Failure: " << result.description());
+
+    ROS_INFO_STREAM("Failure: " << result.description());
   }
 
-  ROS_INFO_STREAM("All " << sample_count << " attempts failed.");
+  ROS_INFO_STREAM("All " << i << " attempts failed, " << unreachable << " sampled poses were skipped as unreachable, "
+                          << rollout_tree.reusedSteps() << " steps were reused.");
   res.success = false;
   res.status = 0;
   return true;
 }
 
+bool ServiceWorker::revalidateTrajectoryQuery(kinematics_check::RevalidateTrajectory::Request& req,
+                                              kinematics_check::RevalidateTrajectory::Response& res)
+{
+  const double delta = 0.017;
+  const unsigned maximum_steps = 1000;
+
+  ROS_INFO("Receiving revalidation query");
+  if (!checkParameters(req))
+    return false;
+
+  std::vector<rl::math::Vector> trajectory;
+  for (std::size_t i = 0; i < req.trajectory.size(); i += ifco_scene->dof())
+    trajectory.push_back(utilities::stdToEigen(
+        std::vector<double>(req.trajectory.begin() + i, req.trajectory.begin() + i + ifco_scene->dof())));
+
+  auto world_collision_types = makeCollisionTypes(req.allowed_collisions);
+  setupScene(req);
+
+  JacobianController jacobian_controller(ifco_scene->getKinematics(), ifco_scene->getBulletScene(), delta,
+                                         maximum_steps, ifco_scene->getViewer());
+
+  Eigen::Affine3d ifco_transform, previous_ifco_transform;
+  tf::poseMsgToEigen(req.ifco_pose, ifco_transform);
+  tf::poseMsgToEigen(req.previous_ifco_pose, previous_ifco_transform);
+
+  std::size_t collision_queries = 0;
+  JacobianController::SingleResult result;
+  if (req.incremental && ifco_transform.isApprox(previous_ifco_transform, 1.0e-6))
+  {
+    // the bounds of the changed boxes before and after the change
+    std::vector<Aabb> changed_boxes;
+    for (auto& box : changedBoxes(getBoxes(req.previous_bounding_boxes_with_poses),
+                                  getBoxes(req.bounding_boxes_with_poses)))
+      changed_boxes.push_back(
+          Aabb::ofBox(box.pose, rl::math::Vector3(box.dimensions[0], box.dimensions[1], box.dimensions[2])));
+
+    ROS_INFO_STREAM("Revalidating a trajectory of " << trajectory.size() << " steps, " << changed_boxes.size()
+                                                    << " bounding boxes changed");
+    result = jacobian_controller.checkTrajectory(trajectory, world_collision_types, changed_boxes, &collision_queries);
+  }
+  else
+  {
+    ROS_INFO_STREAM("Revalidating a trajectory of " << trajectory.size() << " steps in a new scene");
+    result = jacobian_controller.checkTrajectory(trajectory, world_collision_types);
+    collision_queries = result.trajectory.size();
+  }
+
+  // a trajectory that terminates on a contact before its end would be cut short
+  res.success = result && result.trajectory.size() == trajectory.size();
+  res.description = result.description();
+  res.final_step = result.trajectory.size() - 1;
+  res.number_of_collision_queries = collision_queries;
+
+  ROS_INFO_STREAM("Revalidation " << (res.success ? "success" : "failure") << " at step " << res.final_step << ": "
+                                  << res.description << ", " << collision_queries << " collision queries");
+  return true;
+}
+
+bool ServiceWorker::checkKinematicsBeliefQuery(kinematics_check::CheckKinematicsBelief::Request& req,
+                                               kinematics_check::CheckKinematicsBelief::Response& res)
+{
+  const double delta = 0.017;
+  const unsigned maximum_steps = 1000;
+
+  ROS_INFO("Receiving belief query");
+  if (!checkParameters(req))
+    return false;
+
+  Eigen::Affine3d goal_transform;
+  tf::poseMsgToEigen(req.goal_pose, goal_transform);
+  auto initial_configuration = utilities::stdToEigen(req.initial_configuration);
+
+  auto world_collision_types = makeCollisionTypes(req.allowed_collisions);
+  setupScene(req);
+
+  // empty error vectors mean no error
+  JacobianController::MoveBeliefSettings settings;
+  settings.number_of_particles = req.number_of_particles;
+  settings.adaptive = req.adaptive;
+  settings.confidence_interval_width = req.confidence_interval_width;
+  settings.maximum_particles = req.maximum_particles;
+  settings.initial_std_error = req.initial_std_error.empty() ? rl::math::Vector::Zero(ifco_scene->dof()) :
+                                                               utilities::stdToEigen(req.initial_std_error);
+  settings.joints_std_error = req.joints_std_error.empty() ? rl::math::Vector::Zero(ifco_scene->dof()) :
+                                                             utilities::stdToEigen(req.joints_std_error);
+
+  ros::NodeHandle n;
+  n.param("belief_perturbation_tolerance", settings.perturbation_tolerance, 0.0);
+
+  ROS_INFO_STREAM("Propagating a belief of " << settings.number_of_particles << " particles to the goal frame");
+  JacobianController jacobian_controller(ifco_scene->getKinematics(), ifco_scene->getBulletScene(), delta,
+                                         maximum_steps, ifco_scene->getViewer());
+  auto result = jacobian_controller.moveBelief(initial_configuration, goal_transform, world_collision_types, settings);
+
+  res.no_noise_success = result.no_noise_test_result;
+  res.success_rate = result.successRate();
+  if (!res.no_noise_success)
+  {
+    ROS_INFO_STREAM("Noise-free particle failures: " << result.no_noise_test_result.description());
+    return true;
+  }
+
+  res.number_of_particles_used = result.particle_results->size();
+
+  typedef JacobianController::SingleResult::Outcome Outcome;
+  auto counts = result.outcomeCounts();
+  res.reached_count = counts[Outcome::REACHED];
+  res.acceptable_collision_count = counts[Outcome::ACCEPTABLE_COLLISION];
+  res.unacceptable_collision_count = counts[Outcome::UNACCEPTABLE_COLLISION];
+  res.unsensorized_collision_count = counts[Outcome::UNSENSORIZED_COLLISION];
+  res.singularity_count = counts[Outcome::SINGULARITY];
+  res.joint_limit_count = counts[Outcome::JOINT_LIMIT];
+  res.steps_limit_count = counts[Outcome::STEPS_LIMIT];
+  res.missed_required_collisions_count = counts[Outcome::MISSED_REQUIRED_COLLISIONS];
+
+  rl::math::Vector mean_final_configuration = rl::math::Vector::Zero(ifco_scene->dof());
+  for (auto& particle_result : *result.particle_results)
+    mean_final_configuration += particle_result.trajectory.back();
+  if (!result.particle_results->empty())
+    mean_final_configuration /= result.particle_results->size();
+  res.mean_final_configuration = utilities::eigenToStd(mean_final_configuration);
+
+  ROS_INFO_STREAM("Success rate of the belief: " << res.success_rate << " with " << res.number_of_particles_used
+                                                  << " particles");
+  return true;
+}
+
 bool ServiceWorker::cerrtExampleQuery(kinematics_check::CerrtExample::Request& req,
                                       kinematics_check::CerrtExample::Response& res)
 {
@@ -208,19 +484,510 @@ bool ServiceWorker::cerrtExampleQuery(kinematics_check::CerrtExample::Request& r
   auto initial_sampler =
       std::make_shared<BoxUniformOrientationSampler>(initial_transform, std::array<double, 3>{ 0.01, 0.01, 0.01 });
 
+  // makeChooseControllers brings choose_pool up to date, it has to run before the pool is passed on
+  auto choose_controllers = makeChooseControllers(delta, maximum_steps);
   SomaCerrt soma_cerrt(jacobian_controller, noisy_model, choose_sampler, initial_sampler,
                        { { "sensor_Finger1", "box_0" }, { "sensor_Finger2", "box_0" } }, delta,
-                       *ifco_scene->getViewer());
+                       *ifco_scene->getViewer(), choose_controllers, readChooseBudget(), choose_pool);
   soma_cerrt.start = &initial_configuration;
   rl::math::Vector crazy_goal = initial_configuration * 1.1;
   soma_cerrt.goal = &crazy_goal;
   soma_cerrt.goalEpsilon = 0.1;
-  soma_cerrt.solve();
+  if (!soma_cerrt.solve() && soma_cerrt.chooseFailed())
+    ROS_INFO("CERRT stopped, CHOOSE ran out of its budget");
 
   res.success = true;
   return true;
 }
 
+bool ServiceWorker::planCerrtQuery(kinematics_check::PlanCerrt::Request& req,
+                                   kinematics_check::PlanCerrt::Response& res)
+{
+  using namespace rl::math;
+
+  const double delta = 0.017;
+  const unsigned maximum_steps = 1000;
+
+  ROS_INFO("Receiving CERRT query");
+  if (!checkParameters(req))
+    return false;
+
+  Eigen::Affine3d ifco_transform;
+  Eigen::Affine3d goal_transform;
+  tf::poseMsgToEigen(req.ifco_pose, ifco_transform);
+  tf::poseMsgToEigen(req.goal_pose, goal_transform);
+  auto initial_configuration = utilities::stdToEigen(req.initial_configuration);
+  setupScene(req);
+
+  auto boxes = getBoxes(req.bounding_boxes_with_poses);
+  auto scene_fingerprint = sceneFingerprint(ifco_transform, ifco_scene->dof());
+
+  std::unordered_set<std::pair<std::string, std::string>> required_goal_contacts;
+  for (auto& contact : req.required_goal_contacts)
+    required_goal_contacts.insert({ contact.robot_part, contact.type == contact.BOUNDING_BOX ?
+                                                            getBoxShapeName(contact.box_id) :
+                                                            contact.constraint_name });
+
+  auto jacobian_controller = std::make_shared<JacobianController>(
+      ifco_scene->getKinematics(), ifco_scene->getBulletScene(), delta, maximum_steps, ifco_scene->getViewer());
+  std::unique_ptr<rl::plan::NoisyModel> noisy_model(new rl::plan::NoisyModel);
+  noisy_model->kin = ifco_scene->getKinematics().get();
+  noisy_model->model = ifco_scene->getBulletScene()->getModel(0);
+  noisy_model->scene = ifco_scene->getBulletScene().get();
+
+  Vector errors = Vector::Zero(initial_configuration.size());
+  noisy_model->initialError = &errors;
+  noisy_model->motionError = &errors;
+
+  // exploration samples any orientation in a box around the goal, goal biased samples come from the goal manifold
+  double exploration_size;
+  bool reachability_filter;
+  ros::NodeHandle n;
+  n.param("cerrt_exploration_size", exploration_size, 0.1);
+  n.param("cerrt_reachability_filter", reachability_filter, true);
+
+  auto choose_sampler = std::make_shared<BoxUniformOrientationSampler>(
+      goal_transform, std::array<double, 3>{ exploration_size, exploration_size, exploration_size });
+
+  std::array<double, 3> min_position_deltas, max_position_deltas, min_orientation_deltas, max_orientation_deltas;
+  for (std::size_t i = 0; i < 3; ++i)
+  {
+    min_position_deltas[i] = req.min_position_deltas[i];
+    max_position_deltas[i] = req.max_position_deltas[i];
+    min_orientation_deltas[i] = req.min_orientation_deltas[i];
+    max_orientation_deltas[i] = req.max_orientation_deltas[i];
+  }
+  auto goal_sampler = std::make_shared<DeltaBoxSampler>(goal_transform, min_position_deltas, max_position_deltas,
+                                                        min_orientation_deltas, max_orientation_deltas);
+  auto goal_checker = std::make_shared<DeltaBoxChecker>(goal_transform, min_position_deltas, max_position_deltas,
+                                                        min_orientation_deltas, max_orientation_deltas);
+
+  noisy_model->setPosition(initial_configuration);
+  noisy_model->updateFrames();
+  auto initial_transform = noisy_model->forwardPosition();
+  auto initial_sampler =
+      std::make_shared<BoxUniformOrientationSampler>(initial_transform, std::array<double, 3>{ 0.01, 0.01, 0.01 });
+
+  auto choose_controllers = makeChooseControllers(delta, maximum_steps);
+  SomaCerrt soma_cerrt(jacobian_controller, noisy_model.get(), choose_sampler, initial_sampler,
+                       required_goal_contacts, delta, ifco_scene->getViewer().get_value_or(nullptr),
+                       choose_controllers, readChooseBudget(), choose_pool);
+  soma_cerrt.setGoalPose(goal_transform);
+  soma_cerrt.setGoalRegion(goal_sampler, goal_checker, req.goal_bias);
+  if (reachability_filter)
+    soma_cerrt.setReachabilityFilter(makeReachabilityChecker(initial_configuration));
+  if (!req.allowed_collisions.empty())
+    soma_cerrt.setCollisionTypes(std::make_shared<WorldCollisionTypes>(makeCollisionTypes(req.allowed_collisions)));
+  if (req.seed != 0)
+    soma_cerrt.setSeed(req.seed);
+
+  std::string sampling_mode;
+  n.param("sampling_mode", sampling_mode, std::string("halton"));
+  soma_cerrt.setLowDiscrepancyGoalSampling(sampling_mode != "uniform");
+  soma_cerrt.setTimeBudget(req.time_budget);
+
+  if (req.warm_start)
+  {
+    auto stored_tree = loadCerrtTree(scene_fingerprint);
+    if (stored_tree)
+      soma_cerrt.setWarmStart(stored_tree, changedBoxes(stored_tree->boxes, boxes));
+  }
+
+  // the goal is checked in the workspace by isAdmissableGoal, CERRT still needs a goal configuration. This one lies
+  // outside of the joint limits and is never reached
+  soma_cerrt.start = &initial_configuration;
+  Vector unreachable_goal = Vector::Constant(initial_configuration.size(), 1.0e3);
+  soma_cerrt.goal = &unreachable_goal;
+
+  ROS_INFO_STREAM("Planning with CERRT for at most " << req.time_budget << " seconds");
+  res.success = soma_cerrt.solve();
+  res.time_budget_spent = soma_cerrt.timeBudgetSpent();
+
+  auto best_path = soma_cerrt.getBestPath();
+  if (!best_path.empty())
+  {
+    res.trajectory = utilities::concatanateEigneToStd(best_path, ifco_scene->dof());
+    res.best_goal_distance = soma_cerrt.getBestGoalDistance();
+  }
+
+  if (req.warm_start)
+  {
+    auto snapshot = std::make_shared<CerrtTreeSnapshot>(soma_cerrt.makeSnapshot());
+    snapshot->scene_fingerprint = scene_fingerprint;
+    snapshot->boxes = boxes;
+    storeCerrtTree(snapshot);
+  }
+
+  auto& statistics = soma_cerrt.getStatistics();
+  res.number_of_vertices = soma_cerrt.getNumberOfVertices();
+  res.number_of_choose_calls = statistics.choose_calls;
+  res.number_of_expansions = statistics.expansions;
+  res.number_of_goal_checks = statistics.goal_checks;
+  res.choose_time = statistics.choose_seconds;
+  res.goal_check_time = statistics.goal_check_seconds;
+  res.total_time = statistics.total_seconds;
+  res.expansion_time = std::max(0.0, res.total_time - res.choose_time - res.goal_check_time);
+  res.number_of_rejected_samples = statistics.rejected_samples;
+  res.number_of_restored_vertices = statistics.restored_vertices;
+  res.number_of_pruned_vertices = statistics.pruned_vertices;
+  res.number_of_revalidated_edges = statistics.revalidated_edges;
+
+  ROS_INFO_STREAM("CERRT " << (res.success ? "found" : "did not find") << " a goal belief in " << res.total_time
+                           << " seconds with " << res.number_of_vertices << " vertices and "
+                           << res.number_of_expansions << " expansions");
+  return true;
+}
+
+std::vector<std::shared_ptr<JacobianController>> ServiceWorker::makeChooseControllers(double delta,
+                                                                                      unsigned maximum_steps)
+{
+  // CHOOSE runs its rollouts in parallel, every thread needs a scene of its own. The expansion stays on this thread
+  int choose_threads;
+  ros::NodeHandle n;
+  n.param("cerrt_choose_threads", choose_threads, static_cast<int>(std::thread::hardware_concurrency()));
+
+  // loading a copy builds all of its collision shapes, the copies of earlier requests are only brought up to date
+  std::size_t number_of_scenes = std::max(choose_threads, 1);
+  for (auto& choose_scene : choose_scenes)
+    choose_scene->synchronize(*ifco_scene);
+  choose_scenes.resize(std::min(choose_scenes.size(), number_of_scenes));
+  while (choose_scenes.size() < number_of_scenes)
+    choose_scenes.push_back(ifco_scene->clone());
+
+  if (!choose_pool || choose_pool->size() != number_of_scenes)
+    choose_pool = std::make_shared<WorkerPool>(number_of_scenes);
+
+  std::vector<std::shared_ptr<JacobianController>> choose_controllers;
+  for (auto& choose_scene : choose_scenes)
+    choose_controllers.push_back(std::make_shared<JacobianController>(
+        choose_scene->getKinematics(), choose_scene->getBulletScene(), delta, maximum_steps));
+
+  return choose_controllers;
+}
+
+SomaCerrt::ChooseBudget ServiceWorker::readChooseBudget() const
+{
+  SomaCerrt::ChooseBudget choose_budget;
+  int choose_attempts;
+  ros::NodeHandle n;
+  n.param("cerrt_choose_attempts", choose_attempts, static_cast<int>(choose_budget.maximum_attempts));
+  choose_budget.maximum_attempts = choose_attempts;
+  n.param("cerrt_choose_seconds", choose_budget.maximum_seconds, choose_budget.maximum_seconds);
+
+  return choose_budget;
+}
+
+std::shared_ptr<WorkspaceChecker> ServiceWorker::makeReachabilityChecker(const rl::math::Vector& configuration)
+{
+  if (reachability_map)
+    return std::make_shared<ReachabilityChecker>(reachability_map);
+
+  // the distances between consecutive frame origins do not change with the joints, so their sum bounds the distance
+  // of the end effector from the first frame
+  auto kinematics = ifco_scene->getKinematics();
+  kinematics->setPosition(configuration);
+  kinematics->updateFrames();
+
+  double reach = 0;
+  for (std::size_t i = 1; i < kinematics->getFrames(); ++i)
+    reach += (kinematics->getFrame(i).translation() - kinematics->getFrame(i - 1).translation()).norm();
+
+  return std::make_shared<SphereChecker>(kinematics->getFrame(0).translation(), reach);
+}
+
+boost::optional<std::vector<rl::math::Vector>>
+ServiceWorker::approachThroughRoadmap(JacobianController& controller, const rl::math::Transform& ifco_pose,
+                                      const rl::math::Vector& initial_configuration,
+                                      const rl::math::Transform& goal_pose, const CollisionTypes& collision_types,
+                                      std::size_t seeds)
+{
+  if (seeds == 0)
+    return boost::none;
+
+  auto& motions = getApproachMotions(ifco_pose);
+  for (auto node : approach_roadmap->nearest(ifco_pose, goal_pose, seeds))
+  {
+    auto& node_name = approach_roadmap->nodes()[node].name;
+    auto trajectory = motions.connect(controller, node, initial_configuration);
+    if (!trajectory)
+    {
+      ROS_INFO_STREAM("The approach node " << node_name << " cannot be reached");
+      continue;
+    }
+
+    // the roadmap is free of contacts, so all required collisions have to be seen on the way from the node
+    auto result = controller.moveSingleParticle(trajectory->back(), goal_pose, collision_types);
+    if (!result)
+    {
+      ROS_INFO_STREAM("From the approach node " << node_name << ": " << result.description());
+      continue;
+    }
+
+    ROS_INFO_STREAM("Success from the approach node " << node_name << ": " << result.description());
+    trajectory->insert(trajectory->end(), result.trajectory.begin() + 1, result.trajectory.end());
+    return trajectory;
+  }
+
+  return boost::none;
+}
+
+ApproachMotions& ServiceWorker::getApproachMotions(const rl::math::Transform& ifco_pose)
+{
+  const std::size_t maximum_ifco_poses = 16;
+
+  if (!approach_roadmap)
+  {
+    // the inside of the IFCO is taken from its model unless it is given, the end effector points down by default. The
+    // orientation is a quaternion given as w, x, y, z
+    ros::NodeHandle n;
+    std::vector<double> bottom_center, inner_dimensions, orientation;
+    double clearance, inset;
+    n.param("approach_orientation", orientation, { 0, 1, 0, 0 });
+    n.param("approach_clearance", clearance, 0.1);
+    n.param("approach_inset", inset, 0.08);
+
+    if (orientation.size() != 4)
+    {
+      ROS_WARN("The approach orientation has a wrong size, using the default");
+      orientation = { 0, 1, 0, 0 };
+    }
+
+    auto container = ApproachRoadmap::Container::fromParts(ifco_scene->getIfcoParts());
+    if (n.hasParam("approach_ifco_bottom_center") || n.hasParam("approach_ifco_inner_dimensions") || !container)
+    {
+      // the inside of model/rlsg/ifco.wrl, whose walls are named after the directions of a map
+      n.param("approach_ifco_bottom_center", bottom_center, { 0.6, 0, 0.12 });
+      n.param("approach_ifco_inner_dimensions", inner_dimensions, { 0.3635, 0.564, 0.175 });
+      if (bottom_center.size() != 3 || inner_dimensions.size() != 3)
+      {
+        ROS_WARN("The approach IFCO parameters have wrong sizes, using the defaults");
+        bottom_center = { 0.6, 0, 0.12 };
+        inner_dimensions = { 0.3635, 0.564, 0.175 };
+      }
+
+      container = ApproachRoadmap::Container();
+      container->bottom_center = rl::math::Vector3(bottom_center[0], bottom_center[1], bottom_center[2]);
+      container->inner_dimensions = rl::math::Vector3(inner_dimensions[0], inner_dimensions[1], inner_dimensions[2]);
+      container->wall_names = { { "west", "east", "south", "north" } };
+      container->bottom_name = "bottom";
+    }
+
+    ROS_INFO_STREAM("The approach roadmap covers an inside of "
+                    << container->inner_dimensions.transpose() << " above " << container->bottom_center.transpose());
+
+    rl::math::Quaternion approach_orientation(orientation[0], orientation[1], orientation[2], orientation[3]);
+    approach_roadmap =
+        std::make_shared<ApproachRoadmap>(*container, approach_orientation.normalized(), clearance, inset);
+  }
+
+  auto scene_fingerprint = sceneFingerprint(ifco_pose, ifco_scene->dof());
+  auto motions = approach_motions.find(scene_fingerprint);
+  if (motions != approach_motions.end())
+    return motions->second;
+
+  // the IFCO rarely returns to an old pose once it is moved, forget all of them instead of tracking their use
+  if (approach_motions.size() >= maximum_ifco_poses)
+    approach_motions.clear();
+
+  return approach_motions.emplace(scene_fingerprint, ApproachMotions(approach_roadmap, ifco_pose)).first->second;
+}
+
+std::shared_ptr<const CerrtTreeSnapshot> ServiceWorker::loadCerrtTree(std::uint64_t scene_fingerprint)
+{
+  // the trees of a few IFCO poses are kept in memory, the others are read again from their files
+  ros::NodeHandle n;
+  int cache_size;
+  n.param("cerrt_tree_cache_size", cache_size, 8);
+  cerrt_trees.setCapacity(std::max(cache_size, 0));
+
+  auto stored_tree = cerrt_trees.find(scene_fingerprint);
+  if (stored_tree)
+    return *stored_tree;
+
+  auto file_name = getCerrtTreeFile(scene_fingerprint);
+  if (file_name.empty())
+    return nullptr;
+
+  std::ifstream file(file_name, std::ios::binary);
+  if (!file)
+    return nullptr;
+
+  try
+  {
+    auto snapshot = std::make_shared<const CerrtTreeSnapshot>(CerrtTreeSnapshot::load(file));
+    cerrt_trees.insert(scene_fingerprint, snapshot);
+    ROS_INFO_STREAM("Loaded a CERRT tree with " << snapshot->vertices.size() << " vertices from " << file_name);
+    return snapshot;
+  }
+  catch (const std::runtime_error& e)
+  {
+    ROS_WARN_STREAM("Could not load the CERRT tree " << file_name << ": " << e.what());
+    return nullptr;
+  }
+}
+
+void ServiceWorker::storeCerrtTree(std::shared_ptr<const CerrtTreeSnapshot> snapshot)
+{
+  cerrt_trees.insert(snapshot->scene_fingerprint, snapshot);
+
+  auto file_name = getCerrtTreeFile(snapshot->scene_fingerprint);
+  if (file_name.empty())
+    return;
+
+  try
+  {
+    std::ofstream file(file_name, std::ios::binary | std::ios::trunc);
+    snapshot->save(file);
+  }
+  catch (const std::runtime_error& e)
+  {
+    ROS_WARN_STREAM("Could not store the CERRT tree " << file_name << ": " << e.what());
+  }
+}
+
+std::string ServiceWorker::getCerrtTreeFile(std::uint64_t scene_fingerprint) const
+{
+  std::string directory;
+  ros::NodeHandle n;
+  n.param("cerrt_tree_directory", directory, directory);
+  if (directory.empty())
+    return directory;
+
+  std::stringstream ss;
+  ss << directory << "/cerrt_tree_" << std::hex << scene_fingerprint << ".bin";
+  return ss.str();
+}
+
+template <class Request> void ServiceWorker::setupScene(const Request& req)
+{
+  Eigen::Affine3d ifco_transform;
+  tf::poseMsgToEigen(req.ifco_pose, ifco_transform);
+
+  ROS_INFO("Setting ifco pose and creating bounding boxes");
+  ifco_scene->moveIfco(ifco_transform);
+  ifco_scene->removeBoxes();
+  for (std::size_t i = 0; i < req.bounding_boxes_with_poses.size(); ++i)
+  {
+    Eigen::Affine3d box_transform;
+    tf::poseMsgToEigen(req.bounding_boxes_with_poses[i].pose, box_transform);
+    ifco_scene->createBox(req.bounding_boxes_with_poses[i].box.dimensions, box_transform, getBoxName(i));
+  }
+}
+
+std::vector<CerrtTreeSnapshot::Box>
+ServiceWorker::getBoxes(const std::vector<kinematics_check::BoundingBoxWithPose>& bounding_boxes_with_poses) const
+{
+  std::vector<CerrtTreeSnapshot::Box> boxes;
+  for (std::size_t i = 0; i < bounding_boxes_with_poses.size(); ++i)
+  {
+    Eigen::Affine3d box_transform;
+    tf::poseMsgToEigen(bounding_boxes_with_poses[i].pose, box_transform);
+    boxes.push_back({ getBoxShapeName(i), bounding_boxes_with_poses[i].box.dimensions, box_transform });
+  }
+
+  return boxes;
+}
+
+ServiceWorker::CheckKinematicsCacheKey
+ServiceWorker::getCacheKey(const kinematics_check::CheckKinematics::Request& req,
+                           const CheckKinematicsParameters& parameters, double position_resolution,
+                           double angle_resolution) const
+{
+  CheckKinematicsCacheKey key;
+  auto& values = key.values;
+
+  for (auto joint : req.initial_configuration)
+    values.push_back(quantize(joint, angle_resolution));
+
+  Eigen::Affine3d goal_transform, ifco_transform;
+  tf::poseMsgToEigen(req.goal_pose, goal_transform);
+  tf::poseMsgToEigen(req.ifco_pose, ifco_transform);
+  for (auto transform : { &goal_transform, &ifco_transform })
+  {
+    for (int i = 0; i < 3; ++i)
+      values.push_back(quantize(transform->translation()(i), position_resolution));
+    // the entries of a rotation matrix change by at most the angle of a rotation
+    for (int i = 0; i < 3; ++i)
+      for (int j = 0; j < 3; ++j)
+        values.push_back(quantize(transform->linear()(i, j), angle_resolution));
+  }
+
+  for (std::size_t i = 0; i < 3; ++i)
+  {
+    values.push_back(quantize(req.min_position_deltas[i], position_resolution));
+    values.push_back(quantize(req.max_position_deltas[i], position_resolution));
+    values.push_back(quantize(req.min_orientation_deltas[i], angle_resolution));
+    values.push_back(quantize(req.max_orientation_deltas[i], angle_resolution));
+  }
+
+  for (auto& allowed_collision : req.allowed_collisions)
+  {
+    values.push_back(allowed_collision.type);
+    values.push_back(allowed_collision.box_id);
+    values.push_back(allowed_collision.terminate_on_collision);
+    values.push_back(allowed_collision.required_collision);
+    values.push_back(allowed_collision.ignored_collision);
+    key.names.push_back(allowed_collision.constraint_name);
+  }
+
+  // the weights are set and not measured, any change of them counts
+  const double weight_resolution = 1.0e-6;
+  values.push_back(parameters.sample_count);
+  values.push_back(parameters.candidate_pool_factor);
+  values.push_back(quantize(parameters.candidate_weights.distance, weight_resolution));
+  values.push_back(quantize(parameters.candidate_weights.manipulability, weight_resolution));
+  values.push_back(quantize(parameters.candidate_weights.clearance, weight_resolution));
+  values.push_back(parameters.approach_roadmap_seeds);
+  values.push_back(parameters.reuse_rollout_prefixes);
+  key.names.push_back(parameters.sampling_mode);
+
+  return key;
+}
+
+std::size_t ServiceWorker::CheckKinematicsCacheKeyHash::operator()(const CheckKinematicsCacheKey& key) const
+{
+  std::size_t seed = boost::hash_range(key.values.begin(), key.values.end());
+  boost::hash_combine(seed, boost::hash_range(key.names.begin(), key.names.end()));
+  return seed;
+}
+
+bool ServiceWorker::isValid(const CheckKinematicsCacheEntry& entry,
+                            const std::vector<CerrtTreeSnapshot::Box>& boxes) const
+{
+  auto changed = changedBoxes(entry.boxes, boxes);
+  if (entry.trajectory_bounds.empty())
+    return changed.empty();
+
+  return std::none_of(changed.begin(), changed.end(), [&entry](const CerrtTreeSnapshot::Box& box) {
+    if (box.dimensions.size() != 3)
+      return true;
+
+    rl::math::Vector3 dimensions(box.dimensions[0], box.dimensions[1], box.dimensions[2]);
+    return Aabb::ofBox(box.pose, dimensions).intersects(entry.trajectory_bounds);
+  });
+}
+
+WorldCollisionTypes
+ServiceWorker::makeCollisionTypes(const std::vector<kinematics_check::AllowedCollision>& allowed_collisions) const
+{
+  WorldCollisionTypes::PartToCollisionType part_to_type;
+  for (auto& allowed_collision_msg : allowed_collisions)
+  {
+    auto object_name = allowed_collision_msg.type == allowed_collision_msg.BOUNDING_BOX ?
+                           getBoxShapeName(allowed_collision_msg.box_id) :
+                           allowed_collision_msg.constraint_name;
+    CollisionType type;
+
+    type.terminating = allowed_collision_msg.terminate_on_collision;
+    type.required = allowed_collision_msg.required_collision;
+    type.ignored = allowed_collision_msg.ignored_collision;
+
+    part_to_type.insert({ object_name, type });
+  }
+
+  return WorldCollisionTypes(part_to_type);
+}
+
 std::string ServiceWorker::getBoxName(std::size_t box_id) const
 {
   std::stringstream ss;
@@ -253,6 +1020,74 @@ bool ServiceWorker::checkParameters(const kinematics_check::CheckKinematics::Req
     all_ok = false;
   }
 
+  if (!checkDeltas(req))
+    all_ok = false;
+
+  if (!all_ok)
+    return false;
+
+  return true;
+}
+
+bool ServiceWorker::checkParameters(const kinematics_check::RevalidateTrajectory::Request& req)
+{
+  bool all_ok = true;
+
+  if (req.trajectory.empty() || req.trajectory.size() % ifco_scene->dof() != 0)
+  {
+    ROS_ERROR_STREAM("The trajectory size: " << req.trajectory.size()
+                                             << " is not a positive multiple of the degrees of freedom of the robot: "
+                                             << ifco_scene->dof());
+    all_ok = false;
+  }
+
+  for (auto boxes : { &req.bounding_boxes_with_poses, &req.previous_bounding_boxes_with_poses })
+    for (auto& box : *boxes)
+      if (box.box.dimensions.size() != 3)
+      {
+        ROS_ERROR_STREAM("A bounding box has " << box.box.dimensions.size() << " dimensions instead of 3");
+        all_ok = false;
+      }
+
+  return all_ok;
+}
+
+bool ServiceWorker::checkParameters(const kinematics_check::PlanCerrt::Request& req)
+{
+  bool all_ok = true;
+
+  if (req.initial_configuration.size() != ifco_scene->dof())
+  {
+    ROS_ERROR_STREAM("The initial configuration size: " << req.initial_configuration.size()
+                                                        << " does not match the degrees of freedom of the robot: "
+                                                        << ifco_scene->dof());
+    all_ok = false;
+  }
+
+  if (!checkDeltas(req))
+    all_ok = false;
+
+  if (req.goal_bias < 0 || req.goal_bias > 1)
+  {
+    ROS_ERROR_STREAM("The goal_bias: " << req.goal_bias << " is not within [0, 1]");
+    all_ok = false;
+  }
+
+  // SomaCerrt interns every required goal contact as one bit of a 64-bit mask
+  if (req.required_goal_contacts.size() > 64)
+  {
+    ROS_ERROR_STREAM("There are " << req.required_goal_contacts.size()
+                                  << " required goal contacts, at most 64 are supported");
+    all_ok = false;
+  }
+
+  return all_ok;
+}
+
+template <class Request> bool ServiceWorker::checkDeltas(const Request& req)
+{
+  bool all_ok = true;
+
   for (std::size_t i = 0; i < req.min_position_deltas.size(); ++i)
   {
     if (req.min_position_deltas[i] > req.max_position_deltas[i])
@@ -272,8 +1107,49 @@ bool ServiceWorker::checkParameters(const kinematics_check::CheckKinematics::Req
     }
   }
 
-  if (!all_ok)
-    return false;
+  return all_ok;
+}
 
-  return true;
+bool ServiceWorker::checkParameters(const kinematics_check::CheckKinematicsBelief::Request& req)
+{
+  bool all_ok = true;
+
+  if (req.initial_configuration.size() != ifco_scene->dof())
+  {
+    ROS_ERROR_STREAM("The initial configuration size: " << req.initial_configuration.size()
+                                                        << " does not match the degrees of freedom of the robot: "
+                                                        << ifco_scene->dof());
+    all_ok = false;
+  }
+
+  if (!req.initial_std_error.empty() && req.initial_std_error.size() != ifco_scene->dof())
+  {
+    ROS_ERROR_STREAM("The initial_std_error size: " << req.initial_std_error.size()
+                                                    << " does not match the degrees of freedom of the robot: "
+                                                    << ifco_scene->dof());
+    all_ok = false;
+  }
+
+  if (!req.joints_std_error.empty() && req.joints_std_error.size() != ifco_scene->dof())
+  {
+    ROS_ERROR_STREAM("The joints_std_error size: " << req.joints_std_error.size()
+                                                   << " does not match the degrees of freedom of the robot: "
+                                                   << ifco_scene->dof());
+    all_ok = false;
+  }
+
+  if (req.number_of_particles == 0)
+  {
+    ROS_ERROR("The number_of_particles must be positive");
+    all_ok = false;
+  }
+
+  if (req.adaptive && (req.confidence_interval_width <= 0 || req.maximum_particles < req.number_of_particles))
+  {
+    ROS_ERROR_STREAM("Adaptive mode needs a positive confidence_interval_width and maximum_particles: "
+                     << req.maximum_particles << " of at least number_of_particles: " << req.number_of_particles);
+    all_ok = false;
+  }
+
+  return all_ok;
 }
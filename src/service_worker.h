@@ -19,23 +19,46 @@
 #include <eigen_conversions/eigen_msg.h>
 #include "kinematics_check/CheckKinematics.h"
 #include "kinematics_check/CerrtExample.h"
+#include "kinematics_check/CheckKinematicsBelief.h"
+#include "kinematics_check/PlanCerrt.h"
+#include "kinematics_check/RevalidateTrajectory.h"
 
 #include "MainWindow.h"
 #include "ifco_scene.h"
+#include "collision_types.h"
+#include "soma_cerrt.h"
+#include "reachability_map.h"
+#include "approach_roadmap.h"
+#include "candidate_scoring.h"
+#include "aabb.h"
+#include "lru_cache.h"
+
+class JacobianController;
 
 class ServiceWorker : public QObject
 {
   Q_OBJECT
 
 public:
-  ServiceWorker(std::unique_ptr<IfcoScene> ifco_scene) : QObject(nullptr), ifco_scene(std::move(ifco_scene))
+  /* @param reachability_map If given, sampled poses that it marks as unreachable are skipped without a rollout. */
+  ServiceWorker(std::unique_ptr<IfcoScene> ifco_scene,
+                std::shared_ptr<const ReachabilityMap> reachability_map = nullptr)
+    : QObject(nullptr), ifco_scene(std::move(ifco_scene)), reachability_map(reachability_map)
   {
   }
 
   bool checkKinematicsQuery(kinematics_check::CheckKinematics::Request& req,
                             kinematics_check::CheckKinematics::Response& res);
 
+  bool checkKinematicsBeliefQuery(kinematics_check::CheckKinematicsBelief::Request& req,
+                                  kinematics_check::CheckKinematicsBelief::Response& res);
+
   bool cerrtExampleQuery(kinematics_check::CerrtExample::Request& req, kinematics_check::CerrtExample::Response& res);
+
+  bool planCerrtQuery(kinematics_check::PlanCerrt::Request& req, kinematics_check::PlanCerrt::Response& res);
+
+  bool revalidateTrajectoryQuery(kinematics_check::RevalidateTrajectory::Request& req,
+                                 kinematics_check::RevalidateTrajectory::Response& res);
   void start(unsigned rate);
 
 public slots:
@@ -43,13 +66,132 @@ public slots:
   void stop();
 
 private:
+  /* The parameters of check_kinematics that are read from the parameter server for every request. */
+  struct CheckKinematicsParameters
+  {
+    int sample_count;
+    std::string sampling_mode;
+    int candidate_pool_factor;
+    CandidateScorer::Weights candidate_weights;
+    int approach_roadmap_seeds;
+    bool reuse_rollout_prefixes;
+
+    static CheckKinematicsParameters read();
+  };
+
+  /* Everything a response of check_kinematics depends on but the bounding boxes. The values are quantized, so that
+   * nearly identical requests have equal keys.
+   */
+  struct CheckKinematicsCacheKey
+  {
+    std::vector<std::int64_t> values;
+    std::vector<std::string> names;
+
+    bool operator==(const CheckKinematicsCacheKey& other) const
+    {
+      return values == other.values && names == other.names;
+    }
+  };
+
+  struct CheckKinematicsCacheKeyHash
+  {
+    std::size_t operator()(const CheckKinematicsCacheKey& key) const;
+  };
+
+  /* A response of check_kinematics together with the scene it was computed in. */
+  struct CheckKinematicsCacheEntry
+  {
+    kinematics_check::CheckKinematics::Response response;
+    std::vector<CerrtTreeSnapshot::Box> boxes;
+    /* Bounds of the robot along the trajectory of the response, empty if the response has no trajectory. */
+    Aabb trajectory_bounds;
+  };
+
+  /* checkKinematicsQuery without the result cache. */
+  bool checkKinematicsRollouts(kinematics_check::CheckKinematics::Request& req,
+                               kinematics_check::CheckKinematics::Response& res,
+                               const CheckKinematicsParameters& parameters);
+
+  /* The key of everything in a request but the bounding boxes: the initial configuration, the goal pose, the deltas,
+   * the allowed collisions and the IFCO pose, and of the parameters. Positions are quantized to position_resolution
+   * and angles, joints included, to angle_resolution, so that requests closer than that share a key.
+   */
+  CheckKinematicsCacheKey getCacheKey(const kinematics_check::CheckKinematics::Request& req,
+                                      const CheckKinematicsParameters& parameters, double position_resolution,
+                                      double angle_resolution) const;
+
+  /* A cached response is valid as long as no box that changed since is near its trajectory. A response without a
+   * trajectory is valid only if no box changed at all.
+   */
+  bool isValid(const CheckKinematicsCacheEntry& entry, const std::vector<CerrtTreeSnapshot::Box>& boxes) const;
+
   std::string getBoxName(std::size_t box_id) const;
   std::string getBoxShapeName(std::size_t box_id) const;
   std::size_t getBoxId(const std::string& box_name) const;
 
+  /* Move the IFCO and create the bounding boxes of a request. */
+  template <class Request> void setupScene(const Request& req);
+
+  /* The bounding boxes of a request, named like their shapes in the scene. */
+  std::vector<CerrtTreeSnapshot::Box>
+  getBoxes(const std::vector<kinematics_check::BoundingBoxWithPose>& bounding_boxes_with_poses) const;
+
+  WorldCollisionTypes
+  makeCollisionTypes(const std::vector<kinematics_check::AllowedCollision>& allowed_collisions) const;
+
+  /* Controllers for the parallel CHOOSE of SomaCerrt, each on its own copy of the scene. The copies and the threads of
+   * choose_pool are kept between requests and only recreated if cerrt_choose_threads changes.
+   */
+  std::vector<std::shared_ptr<JacobianController>> makeChooseControllers(double delta, unsigned maximum_steps);
+  SomaCerrt::ChooseBudget readChooseBudget() const;
+
+  /* The reachability map if one was loaded, otherwise a sphere around the robot base with the largest distance the
+   * end effector can reach.
+   */
+  std::shared_ptr<WorkspaceChecker> makeReachabilityChecker(const rl::math::Vector& configuration);
+
+  /* Reach the goal pose from the configuration of one of the seeds approach roadmap nodes nearest to it, moving to
+   * that node along the roadmap. The trajectory from initial_configuration to the goal pose, or none if no node worked.
+   */
+  boost::optional<std::vector<rl::math::Vector>>
+  approachThroughRoadmap(JacobianController& controller, const rl::math::Transform& ifco_pose,
+                         const rl::math::Vector& initial_configuration, const rl::math::Transform& goal_pose,
+                         const CollisionTypes& collision_types, std::size_t seeds);
+
+  /* The approach motions kept for an IFCO pose, the roadmap is created from the ros parameters on first use. */
+  ApproachMotions& getApproachMotions(const rl::math::Transform& ifco_pose);
+
+  std::shared_ptr<const CerrtTreeSnapshot> loadCerrtTree(std::uint64_t scene_fingerprint);
+  void storeCerrtTree(std::shared_ptr<const CerrtTreeSnapshot> snapshot);
+  std::string getCerrtTreeFile(std::uint64_t scene_fingerprint) const;
+
   bool checkParameters(const kinematics_check::CheckKinematics::Request& req);
+  bool checkParameters(const kinematics_check::CheckKinematicsBelief::Request& req);
+  bool checkParameters(const kinematics_check::PlanCerrt::Request& req);
+  bool checkParameters(const kinematics_check::RevalidateTrajectory::Request& req);
+
+  /* Whether the minimum position and orientation deltas of a request are not larger than the maximum ones. */
+  template <class Request> bool checkDeltas(const Request& req);
 
   std::unique_ptr<IfcoScene> ifco_scene;
+  /* Copies of ifco_scene for the CHOOSE threads of SomaCerrt, and the threads. */
+  std::vector<std::unique_ptr<IfcoScene>> choose_scenes;
+  std::shared_ptr<WorkerPool> choose_pool;
+  std::shared_ptr<const ReachabilityMap> reachability_map;
+  /* CERRT trees kept for warm starts, by scene fingerprint, at most cerrt_tree_cache_size of them. They are also
+   * written to and read from the directory in the parameter cerrt_tree_directory, if it is set, so that they survive a
+   * restart.
+   */
+  LruCache<std::uint64_t, std::shared_ptr<const CerrtTreeSnapshot>> cerrt_trees{ 8 };
+  /* Successful responses of check_kinematics by getCacheKey. A failure is not kept, the poses it sampled are seeded
+   * differently in every request.
+   */
+  LruCache<CheckKinematicsCacheKey, CheckKinematicsCacheEntry, CheckKinematicsCacheKeyHash> check_kinematics_cache{
+    256
+  };
+  std::shared_ptr<const ApproachRoadmap> approach_roadmap;
+  /* Approach motions by scene fingerprint. */
+  std::unordered_map<std::uint64_t, ApproachMotions> approach_motions;
   QTimer loop_timer;
 
   QMutex keep_running_mutex;
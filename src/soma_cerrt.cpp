@@ -3,34 +3,307 @@
 //
 
 #include <rl/plan/NoisyModel.h>
-#include <boost/graph/random.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <iterator>
 
 #include "soma_cerrt.h"
+#include "aabb.h"
 #include "Viewer.h"
 #include "jacobian_controller.h"
 #include "workspace_samplers.h"
 
+namespace
+{
+// the number of poses CHOOSE generates at once per worker and sampler
+const std::size_t pose_batch_size = 16;
+
+// how far from a stored vertex in task space the end of its edge may be when the edge is rolled out again
+const rl::math::Real vertex_position_tolerance = 0.01;
+const rl::math::Real vertex_rotation_tolerance = 0.05;
+
+/* The collision types of the planner with the contacts with changed boxes prohibited. An edge that touches a changed
+ * box is not the edge of the tree any more, the vertices whose particles touched one are dropped before.
+ */
+class ChangedBoxesCollisionTypes : public CollisionTypes
+{
+public:
+  ChangedBoxesCollisionTypes(const CollisionTypes& collision_types,
+                             const std::vector<CerrtTreeSnapshot::Box>& changed_boxes)
+    : collision_types_(collision_types), changed_boxes_(changed_boxes)
+  {
+  }
+
+  CollisionType getCollisionType(const std::string& robot_part, const std::string& world_part) const override
+  {
+    for (auto& box : changed_boxes_)
+    {
+      if (world_part == box.name)
+      {
+        CollisionType prohibited;
+        prohibited.prohibited = true;
+        return prohibited;
+      }
+    }
+
+    return collision_types_.getCollisionType(robot_part, world_part);
+  }
+
+  std::shared_ptr<RequiredCollisionsCounter> makeRequiredCollisionsCounter() const override
+  {
+    return collision_types_.makeRequiredCollisionsCounter();
+  }
+
+private:
+  const CollisionTypes& collision_types_;
+  const std::vector<CerrtTreeSnapshot::Box>& changed_boxes_;
+};
+
+std::set<std::pair<std::string, std::string>>
+toContactSet(const std::vector<std::pair<std::string, std::string>>& contacts)
+{
+  std::set<std::pair<std::string, std::string>> contact_set;
+  for (auto& contact : contacts)
+    contact_set.insert(contact.first < contact.second ? contact : std::make_pair(contact.second, contact.first));
+
+  return contact_set;
+}
+}
+
 SomaCerrt::SomaCerrt(std::shared_ptr<JacobianController> jacobian_controller, rl::plan::NoisyModel* noisy_model,
                      std::shared_ptr<WorkspaceSampler> sampler_for_choose,
                      std::shared_ptr<WorkspaceSampler> initial_sampler,
                      std::unordered_set<std::pair<std::string, std::string>> required_goal_contacts, double delta,
-                     Viewer* viewer)
+                     Viewer* viewer, std::vector<std::shared_ptr<JacobianController>> choose_controllers,
+                     ChooseBudget choose_budget, std::shared_ptr<WorkerPool> choose_pool)
   : Cerrt()
   , jacobian_controller_(jacobian_controller)
   , sampler_for_choose_(sampler_for_choose)
   , initial_sampler_(initial_sampler)
   , viewer_(viewer)
   , required_goal_contacts_(required_goal_contacts)
+  , choose_controllers_(choose_controllers)
+  , choose_pool_(choose_pool)
+  , choose_budget_(choose_budget)
 {
   using namespace rl::math;
   model = noisy_model;
   this->delta = delta;
   goalEpsilon = 0.001;
   random_gen_.seed(std::time(0));
+  default_duration_ = duration;
 
-  collision_types_.reset(new IgnoreAllCollisionTypes);
-  goal_checker_.reset(new BoxChecker(Transform::Identity(), { 0.1, 0.1, 0.1 }, { 0.5, 0.5, 0.5 }));
+  collision_types_ = std::make_shared<IgnoreAllCollisionTypes>();
+  goal_checker_ = std::make_shared<BoxChecker>(Transform::Identity(), std::array<double, 3>{ 0.1, 0.1, 0.1 },
+                                               std::array<double, 3>{ 0.5, 0.5, 0.5 });
   nrParticles = 20;
+
+  if (choose_controllers_.empty())
+    choose_controllers_.push_back(jacobian_controller_);
+  if (!choose_pool_)
+    choose_pool_ = std::make_shared<WorkerPool>(choose_controllers_.size());
+  if (choose_pool_->size() != choose_controllers_.size())
+    throw std::invalid_argument("The CHOOSE pool has " + std::to_string(choose_pool_->size()) + " workers for " +
+                                std::to_string(choose_controllers_.size()) + " controllers");
+
+  if (required_goal_contacts_.size() > 64)
+    throw std::invalid_argument("At most 64 required goal contacts are supported, got " +
+                                std::to_string(required_goal_contacts_.size()));
+  for (auto& contact : required_goal_contacts_)
+  {
+    auto bit = std::uint64_t(1) << goal_contact_bits_.size();
+    goal_contact_bits_[contact] = bit;
+    required_goal_mask_ |= bit;
+  }
+}
+
+bool SomaCerrt::solve()
+{
+  choose_failed_ = false;
+  time_budget_spent_ = false;
+  vertex_index_.clear();
+  statistics_ = Statistics();
+  best_belief_.reset();
+  best_belief_admissible_ = false;
+  best_goal_distance_ = std::numeric_limits<rl::math::Real>::infinity();
+
+  auto start_time = std::chrono::steady_clock::now();
+  solve_deadline_ = std::chrono::steady_clock::time_point::max();
+  if (time_budget_seconds_ > 0)
+  {
+    auto budget = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+        std::chrono::duration<double>(time_budget_seconds_));
+    solve_deadline_ = start_time + budget;
+    duration = budget;
+  }
+  else
+  {
+    duration = default_duration_;
+  }
+
+  // the warm start tree is only valid for the start configuration it was planned from
+  warm_start_pending_ = false;
+  if (warm_start_ && !warm_start_->vertices.empty() &&
+      (warm_start_->vertices.front().mean() - *start).norm() <= delta)
+  {
+    warm_start_valid_ = revalidateWarmStart();
+    warm_start_pending_ = true;
+  }
+
+  proposals_.clear();
+
+  // the goal sequences continue over the CHOOSE calls of a solve
+  goal_sequences_.clear();
+  if (low_discrepancy_goal_sampling_)
+    for (std::size_t i = 0; i < choose_pool_->size(); ++i)
+      goal_sequences_.emplace_back(6, random_gen_());
+
+  bool solved = false;
+  try
+  {
+    solved = Cerrt::solve();
+  }
+  catch (const ChooseFailure& e)
+  {
+    choose_failed_ = true;
+  }
+  catch (const TimeBudgetSpent& e)
+  {
+    time_budget_spent_ = true;
+  }
+
+  if (!solved && std::chrono::steady_clock::now() >= solve_deadline_)
+    time_budget_spent_ = true;
+
+  statistics_.total_seconds =
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+
+  warm_start_.reset();
+  warm_start_changed_boxes_.clear();
+  warm_start_valid_.clear();
+
+  return solved;
+}
+
+void SomaCerrt::setGoalRegion(std::shared_ptr<WorkspaceSampler> goal_sampler,
+                              std::shared_ptr<WorkspaceChecker> goal_checker, double goal_bias)
+{
+  goal_sampler_ = goal_sampler;
+  goal_checker_ = goal_checker;
+  goal_bias_ = goal_bias;
+}
+
+void SomaCerrt::setCollisionTypes(std::shared_ptr<CollisionTypes> collision_types)
+{
+  collision_types_ = collision_types;
+}
+
+void SomaCerrt::setLowDiscrepancyGoalSampling(bool low_discrepancy)
+{
+  low_discrepancy_goal_sampling_ = low_discrepancy;
+}
+
+void SomaCerrt::setReachabilityFilter(std::shared_ptr<WorkspaceChecker> reachability_checker)
+{
+  reachability_checker_ = reachability_checker;
+}
+
+void SomaCerrt::setSeed(std::mt19937::result_type seed)
+{
+  random_gen_.seed(seed);
+}
+
+void SomaCerrt::setTimeBudget(double seconds)
+{
+  time_budget_seconds_ = seconds;
+}
+
+void SomaCerrt::setWarmStart(std::shared_ptr<const CerrtTreeSnapshot> snapshot,
+                             std::vector<CerrtTreeSnapshot::Box> changed_boxes)
+{
+  warm_start_ = snapshot;
+  warm_start_changed_boxes_ = changed_boxes;
+}
+
+CerrtTreeSnapshot SomaCerrt::makeSnapshot() const
+{
+  CerrtTreeSnapshot snapshot;
+  if (boost::num_vertices(tree[0]) == 0)
+    return snapshot;
+
+  // breadth first from the root, so that every parent is stored before its children
+  std::deque<std::pair<Vertex, std::size_t>> open = { { *boost::vertices(tree[0]).first,
+                                                        CerrtTreeSnapshot::Vertex::no_parent } };
+  while (!open.empty())
+  {
+    auto vertex = open.front().first;
+    auto parent = open.front().second;
+    open.pop_front();
+
+    auto& belief = tree[0][vertex].beliefState;
+    if (!belief)
+      continue;
+
+    auto& particles = belief->getParticles();
+    CerrtTreeSnapshot::Vertex stored;
+    stored.parent = parent;
+    stored.particles.resize(particles.empty() ? 0 : particles.front().config.size(), particles.size());
+    stored.contacts.resize(particles.size());
+    for (std::size_t i = 0; i < particles.size(); ++i)
+    {
+      stored.particles.col(i) = particles[i].config;
+      for (auto& contact_and_description : particles[i].contacts)
+        stored.contacts[i].push_back(contact_and_description.first);
+    }
+
+    snapshot.vertices.push_back(std::move(stored));
+    for (auto edges = boost::out_edges(vertex, tree[0]); edges.first != edges.second; ++edges.first)
+      open.push_back({ boost::target(*edges.first, tree[0]), snapshot.vertices.size() - 1 });
+  }
+
+  return snapshot;
+}
+
+void SomaCerrt::setGoalPose(const rl::math::Transform& goal_pose)
+{
+  goal_pose_ = goal_pose;
+}
+
+std::vector<rl::math::Vector> SomaCerrt::getBestPath() const
+{
+  std::vector<rl::math::Vector> path;
+  for (auto vertex : getBestPathVertices())
+    path.push_back(tree[0][vertex].beliefState->configMean());
+
+  return path;
+}
+
+std::vector<SomaCerrt::Vertex> SomaCerrt::getBestPathVertices() const
+{
+  std::vector<Vertex> path;
+  if (!best_belief_)
+    return path;
+
+  auto vertices = boost::vertices(tree[0]);
+  auto best = std::find_if(vertices.first, vertices.second,
+                           [this](Vertex v) { return tree[0][v].beliefState == best_belief_; });
+  if (best == vertices.second)
+    return path;
+
+  // walk up to the root, every vertex but the root has exactly one parent
+  for (auto vertex = *best;;)
+  {
+    path.push_back(vertex);
+    auto parents = boost::in_edges(vertex, tree[0]);
+    if (parents.first == parents.second)
+      break;
+    vertex = boost::source(*parents.first, tree[0]);
+  }
+
+  std::reverse(path.begin(), path.end());
+  return path;
 }
 
 void SomaCerrt::choose(rl::math::Vector& chosen)
@@ -38,19 +311,145 @@ void SomaCerrt::choose(rl::math::Vector& chosen)
   // sample function as discussed needs initial configuration
   // but CHOOSE in CERRT does not reason about initial configurations
   // taking a random vertex to demonstrate behaviour
-  while (true)
+  auto choose_start = std::chrono::steady_clock::now();
+  if (choose_start >= solve_deadline_)
+    throw TimeBudgetSpent();
+
+  ++statistics_.choose_calls;
+
+  // the other valid configurations of an earlier round are used first, they stay valid while the tree grows
+  if (!proposals_.empty())
   {
-    auto random_vertex = boost::random_vertex(tree[0], random_gen_);
-    auto sample = sampleWithJacobianControl(*jacobian_controller_, tree[0][random_vertex].beliefState->configMean(),
-                                            *collision_types_, *sampler_for_choose_, random_gen_,
-                                            maximum_sample_attempts_, delta);
+    chosen = proposals_.front();
+    proposals_.pop_front();
+    ++statistics_.proposals_used;
+    return;
+  }
+
+  // the rollouts start from a vertex of the tree, there is none before the root is added
+  if (vertex_index_.empty())
+    throw ChooseFailure("CHOOSE has no vertex of the tree to start a rollout from");
+
+  auto choose_duration = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+      std::chrono::duration<double>(choose_budget_.maximum_seconds));
+  auto deadline = std::min(solve_deadline_, choose_start + choose_duration);
+  std::atomic<std::size_t> rejected_samples(0);
+
+  // every worker has its own controller and random generator, the seeds come from the planner's generator
+  std::vector<std::mt19937> worker_gens;
+  for (std::size_t i = 0; i < choose_pool_->size(); ++i)
+    worker_gens.emplace_back(random_gen_());
+  std::vector<boost::optional<rl::math::Vector>> round_results(choose_pool_->size());
 
-    if (sample)
+  // the poses are generated in batches, one per worker and sampler
+  std::vector<PoseBatch> exploration_poses(choose_pool_->size()), goal_poses(choose_pool_->size());
+  std::vector<std::size_t> next_exploration_pose(choose_pool_->size(), 0), next_goal_pose(choose_pool_->size(), 0);
+  auto next_pose = [&worker_gens](std::size_t worker, WorkspaceSampler& sampler, PoseBatch& poses, std::size_t& next) {
+    if (next == poses.size())
     {
-      chosen = *sample;
+      sampler.generateBatch(worker_gens[worker], pose_batch_size, poses);
+      next = 0;
+    }
+    return poses.transform(next++);
+  };
+
+  // one rollout per worker and round, the tree is only read while the workers run
+  auto attempt = [&](std::size_t worker) {
+    auto& worker_gen = worker_gens[worker];
+    auto& controller = *choose_controllers_[worker];
+    round_results[worker] = boost::none;
+
+    std::uniform_int_distribution<std::size_t> vertex_distribution(0, vertex_index_.size() - 1);
+    std::uniform_real_distribution<double> bias_distribution;
+    while (std::chrono::steady_clock::now() < deadline)
+    {
+      rl::math::Transform sampled_pose;
+      if (goal_sampler_ && bias_distribution(worker_gen) < goal_bias_)
+        sampled_pose = goal_sequences_.empty() ?
+                           next_pose(worker, *goal_sampler_, goal_poses[worker], next_goal_pose[worker]) :
+                           goal_sampler_->generateFromSequence(goal_sequences_[worker]);
+      else
+        sampled_pose =
+            next_pose(worker, *sampler_for_choose_, exploration_poses[worker], next_exploration_pose[worker]);
+
+      // a rejected pose is not an attempt, only rollouts are
+      if (reachability_checker_ && !reachability_checker_->contains(sampled_pose))
+      {
+        ++rejected_samples;
+        continue;
+      }
+
+      auto random_vertex = vertex_index_[vertex_distribution(worker_gen)];
+      auto from = tree[0][random_vertex].beliefState->configMean();
+      auto result = controller.moveSingleParticle(from, sampled_pose, *collision_types_);
+      if (result)
+        round_results[worker] = result.trajectory.back();
       return;
     }
+  };
+
+  // the results of a round are taken in worker order, so that the chosen configurations depend on the seed and the
+  // number of workers only and not on which thread finishes first
+  bool found = false;
+  unsigned attempts = 0;
+  while (!found && attempts < choose_budget_.maximum_attempts && std::chrono::steady_clock::now() < deadline)
+  {
+    choose_pool_->run(attempt);
+    attempts += choose_pool_->size();
+
+    for (auto& result : round_results)
+    {
+      if (!result)
+        continue;
+
+      if (!found)
+        chosen = *result;
+      else
+        proposals_.push_back(*result);
+      found = true;
+    }
   }
+
+  auto choose_end = std::chrono::steady_clock::now();
+  statistics_.rejected_samples += rejected_samples;
+  statistics_.choose_seconds += std::chrono::duration<double>(choose_end - choose_start).count();
+
+  if (!found && choose_end >= solve_deadline_)
+    throw TimeBudgetSpent();
+  if (!found)
+    throw ChooseFailure("CHOOSE did not find a valid configuration within " +
+                        std::to_string(choose_budget_.maximum_attempts) + " attempts and " +
+                        std::to_string(choose_budget_.maximum_seconds) + " seconds");
+}
+
+SomaCerrt::Vertex SomaCerrt::addVertex(Tree& tree, const rl::plan::VectorPtr& q)
+{
+  auto vertex = Cerrt::addVertex(tree, q);
+  if (&tree == &this->tree[0])
+  {
+    vertex_index_.insert(*q, vertex);
+
+    // the first vertex of a warm started solve is the root, the stored tree is continued from it
+    if (warm_start_pending_)
+    {
+      warm_start_pending_ = false;
+      graftWarmStart(vertex);
+    }
+  }
+
+  return vertex;
+}
+
+SomaCerrt::Neighbor SomaCerrt::nearest(const Tree& tree, const rl::math::Vector& chosen)
+{
+  if (&tree != &this->tree[0])
+    return Cerrt::nearest(tree, chosen);
+
+  ++statistics_.expansions;
+  if (vertex_index_.empty())
+    return Cerrt::nearest(tree, chosen);
+
+  return vertex_index_.nearest(chosen);
 }
 
 void SomaCerrt::sampleInitialParticles(std::vector<rl::plan::Particle>& initialParticles)
@@ -60,23 +459,194 @@ void SomaCerrt::sampleInitialParticles(std::vector<rl::plan::Particle>& initialP
 
 bool SomaCerrt::isAdmissableGoal(boost::shared_ptr<rl::plan::BeliefState> belief)
 {
-  auto& particles = belief->getParticles();
-  // for every particle, check that all required contact pairs are present, and the pose lies within a workspace
-  // goal manifold
+  auto check_start = std::chrono::steady_clock::now();
+  ++statistics_.goal_checks;
+
+  bool admissible = checkGoal(*belief);
+
+  // rank the belief by the distance of its mean end effector pose to the goal pose, an admissible belief is always best
+  rl::math::Real goal_distance = 0;
+  if (goal_pose_)
+  {
+    particle_configuration_ = belief->configMean();
+    model->kin->setPosition(particle_configuration_);
+    model->kin->updateFrames();
+    rl::math::Transform mean_pose = model->kin->forwardPosition();
+    goal_distance = (mean_pose.translation() - goal_pose_->translation()).norm() +
+                    0.1 * rl::math::AngleAxis(mean_pose.linear().transpose() * goal_pose_->linear()).angle();
+  }
+
+  if (!best_belief_admissible_ && (admissible || goal_distance < best_goal_distance_))
+  {
+    best_belief_ = belief;
+    best_belief_admissible_ = admissible;
+    best_goal_distance_ = goal_distance;
+  }
+
+  statistics_.goal_check_seconds +=
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - check_start).count();
+  return admissible;
+}
+
+bool SomaCerrt::checkGoal(rl::plan::BeliefState& belief)
+{
+  auto& particles = belief.getParticles();
+
+  // first check for every particle that all required contact pairs are present
   for (auto& particle : particles)
   {
-    auto nonpresent_contacts = required_goal_contacts_;
+    std::uint64_t present_mask = 0;
     for (auto& contact_and_description : particle.contacts)
-      nonpresent_contacts.erase(contact_and_description.first);
+    {
+      auto bit = goal_contact_bits_.find(contact_and_description.first);
+      if (bit != goal_contact_bits_.end())
+        present_mask |= bit->second;
+    }
 
-    if (!nonpresent_contacts.empty())
+    if (present_mask != required_goal_mask_)
       return false;
+  }
 
-    model->setPosition(particle.config);
-    model->updateFrames();
-    if (!goal_checker_->contains(model->forwardPosition()))
-      return false;
+  // then compute the end effector poses of all particles on the kinematics only, the scene is not needed, and check
+  // that they lie within the workspace goal manifold
+  particle_poses_.resize(particles.size());
+  for (std::size_t i = 0; i < particles.size(); ++i)
+  {
+    model->kin->setPosition(particles[i].config);
+    model->kin->updateFrames();
+    particle_poses_[i] = model->kin->forwardPosition();
+  }
+
+  return goal_checker_->containsAll(particle_poses_);
+}
+
+std::vector<bool> SomaCerrt::revalidateWarmStart()
+{
+  auto& vertices = warm_start_->vertices;
+  std::vector<bool> valid(vertices.size(), true);
+  ChangedBoxesCollisionTypes revalidation_types(*collision_types_, warm_start_changed_boxes_);
+
+  for (std::size_t i = 1; i < vertices.size(); ++i)
+  {
+    auto& vertex = vertices[i];
+    if (!valid[vertex.parent])
+    {
+      valid[i] = false;
+      continue;
+    }
+
+    // a contact with a changed box is not there any more or is somewhere else
+    for (auto& particle_contacts : vertex.contacts)
+      for (auto& contact : particle_contacts)
+        for (auto& box : warm_start_changed_boxes_)
+          if (contact.first == box.name || contact.second == box.name)
+            valid[i] = false;
+
+    if (!valid[i])
+      continue;
+
+    // the edge could run into a new or moved box. Roll out the motion again with the changed boxes prohibited and
+    // require that it still ends at the vertex, with the contacts of its particles
+    auto from = vertices[vertex.parent].mean();
+    auto to = vertex.mean();
+    if (!nearChangedBox(from, to))
+      continue;
+
+    ++statistics_.revalidated_edges;
+    model->kin->setPosition(to);
+    model->kin->updateFrames();
+    rl::math::Transform to_pose = model->kin->forwardPosition();
+    auto result = jacobian_controller_->moveSingleParticle(from, to_pose, revalidation_types);
+    valid[i] = result && reachesVertex(result.trajectory.back(), to_pose, vertex.contacts);
+  }
+
+  return valid;
+}
+
+bool SomaCerrt::reachesVertex(const rl::math::Vector& configuration, const rl::math::Transform& vertex_pose,
+                              const std::vector<std::vector<std::pair<std::string, std::string>>>& vertex_contacts)
+{
+  model->kin->setPosition(configuration);
+  model->kin->updateFrames();
+  rl::math::Transform pose = model->kin->forwardPosition();
+  if ((pose.translation() - vertex_pose.translation()).norm() > vertex_position_tolerance ||
+      rl::math::AngleAxis(pose.linear().transpose() * vertex_pose.linear()).angle() > vertex_rotation_tolerance)
+    return false;
+
+  // the contacts at the end must include those all particles had and may only be ones some particle had
+  std::set<std::pair<std::string, std::string>> shared_contacts, any_contacts;
+  for (std::size_t i = 0; i < vertex_contacts.size(); ++i)
+  {
+    auto particle_contacts = toContactSet(vertex_contacts[i]);
+    any_contacts.insert(particle_contacts.begin(), particle_contacts.end());
+    if (i == 0)
+    {
+      shared_contacts = particle_contacts;
+      continue;
+    }
+
+    std::set<std::pair<std::string, std::string>> intersection;
+    std::set_intersection(shared_contacts.begin(), shared_contacts.end(), particle_contacts.begin(),
+                          particle_contacts.end(), std::inserter(intersection, intersection.begin()));
+    shared_contacts.swap(intersection);
+  }
+
+  auto contacts = toContactSet(jacobian_controller_->contactsAt(configuration));
+  return std::includes(contacts.begin(), contacts.end(), shared_contacts.begin(), shared_contacts.end()) &&
+         std::includes(any_contacts.begin(), any_contacts.end(), contacts.begin(), contacts.end());
+}
+
+bool SomaCerrt::nearChangedBox(const rl::math::Vector& from, const rl::math::Vector& to)
+{
+  if (warm_start_changed_boxes_.empty())
+    return false;
+
+  // the frame origins of the robot at both ends of the edge, grown by the reach of the links, bound the motion of
+  // the short edges of the tree
+  Aabb robot_bounds;
+  for (auto configuration : { &from, &to })
+  {
+    model->kin->setPosition(*configuration);
+    model->kin->updateFrames();
+    robot_bounds.extend(Aabb::ofFrames(*model->kin, jacobian_controller_->linkReach()));
+  }
+
+  for (auto& box : warm_start_changed_boxes_)
+  {
+    rl::math::Vector3 dimensions(box.dimensions[0], box.dimensions[1], box.dimensions[2]);
+    if (Aabb::ofBox(box.pose, dimensions).intersects(robot_bounds))
+      return true;
   }
 
-  return true;
+  return false;
+}
+
+void SomaCerrt::graftWarmStart(Vertex root)
+{
+  auto& vertices = warm_start_->vertices;
+  std::vector<Vertex> grafted(vertices.size(), root);
+
+  for (std::size_t i = 1; i < vertices.size(); ++i)
+  {
+    if (!warm_start_valid_[i])
+    {
+      ++statistics_.pruned_vertices;
+      continue;
+    }
+
+    auto& vertex = vertices[i];
+    std::vector<rl::plan::Particle> particles;
+    for (std::size_t j = 0; j < vertex.contacts.size(); ++j)
+    {
+      rl::plan::Particle particle(vertex.particles.col(j));
+      for (auto& contact : vertex.contacts[j])
+        particle.contacts[contact];
+      particles.push_back(particle);
+    }
+
+    grafted[i] = addVertex(tree[0], boost::make_shared<rl::math::Vector>(vertex.mean()));
+    tree[0][grafted[i]].beliefState = boost::make_shared<rl::plan::BeliefState>(particles, model);
+    addEdge(grafted[vertex.parent], grafted[i], tree[0]);
+    ++statistics_.restored_vertices;
+  }
 }
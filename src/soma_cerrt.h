@@ -8,40 +8,268 @@
 #include <rl/plan/Cerrt.h>
 #include <rl/plan/Particle.h>
 #include <rl/sg/bullet/Scene.h>
+#include <boost/optional.hpp>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <limits>
 #include <random>
+#include <set>
+#include <stdexcept>
 #include "collision_types.h"
 #include "workspace_checkers.h"
 #include "pair_hash.h"
+#include "configuration_index.h"
+#include "cerrt_tree_snapshot.h"
+#include "worker_pool.h"
+#include "low_discrepancy.h"
 
 class Viewer;
 class WorkspaceSampler;
 class JacobianController;
 
 /* An example showing how CHOOSE and goal check can be implemented.
+ *
+ * Only CHOOSE runs on several threads. The expansion of rl::plan::Cerrt::solve, with its belief propagation, and the
+ * goal checks stay on the calling thread and use jacobian_controller.
  */
 class SomaCerrt : public rl::plan::Cerrt
 {
 public:
+  /* Limits of a single CHOOSE. Every attempt is one jacobian control rollout from a random tree vertex to a sampled
+   * pose.
+   */
+  struct ChooseBudget
+  {
+    ChooseBudget() : maximum_attempts(200), maximum_seconds(5)
+    {
+    }
+
+    unsigned maximum_attempts;
+    double maximum_seconds;
+  };
+
+  /* Counters and timings of the last solve. The time not spent in CHOOSE and in goal checks is spent expanding. */
+  struct Statistics
+  {
+    std::size_t choose_calls = 0;
+    // nearest vertex lookups in the first tree, one per expansion towards a chosen configuration
+    std::size_t expansions = 0;
+    std::size_t goal_checks = 0;
+    // sampled poses of CHOOSE rejected by the reachability filter before a rollout
+    std::size_t rejected_samples = 0;
+    // CHOOSE calls answered by a configuration found in an earlier round
+    std::size_t proposals_used = 0;
+    double choose_seconds = 0;
+    double goal_check_seconds = 0;
+    double total_seconds = 0;
+
+    // vertices taken over from the warm start tree, dropped from it and edges rolled out again to check them
+    std::size_t restored_vertices = 0;
+    std::size_t pruned_vertices = 0;
+    std::size_t revalidated_edges = 0;
+  };
+
+  /* Thrown by choose when its budget is spent without finding a valid configuration. */
+  class ChooseFailure : public std::runtime_error
+  {
+  public:
+    ChooseFailure(const std::string& what) : std::runtime_error(what)
+    {
+    }
+  };
+
+  /* Create the planner.
+   *
+   * @param choose_controllers Jacobian controllers for the CHOOSE rollouts, one per thread. Each must use its own
+   * kinematics and bullet scene. If empty, jacobian_controller is used from a single thread. The expansion always
+   * uses jacobian_controller.
+   * @param choose_pool The threads of CHOOSE, one worker per choose controller, so that planners created one after
+   * another can share them. If null, the planner starts its own.
+   */
   SomaCerrt(std::shared_ptr<JacobianController> jacobian_controller, rl::plan::NoisyModel* noisy_model,
             std::shared_ptr<WorkspaceSampler> sampler_for_choose, std::shared_ptr<WorkspaceSampler> initial_sampler,
             std::unordered_set<std::pair<std::string, std::string>> required_goal_contacts, double delta,
-            Viewer* viewer);
+            Viewer* viewer, std::vector<std::shared_ptr<JacobianController>> choose_controllers = {},
+            ChooseBudget choose_budget = ChooseBudget(), std::shared_ptr<WorkerPool> choose_pool = nullptr);
+
+  /* Plan as rl::plan::Cerrt does. Returns false without a solution if a CHOOSE ran out of its budget. */
+  bool solve() override;
+
+  /* Whether the last solve was stopped by a CHOOSE that ran out of its budget. */
+  bool chooseFailed() const
+  {
+    return choose_failed_;
+  }
+
+  /* The goal manifold. A belief is admissible as goal if all particles have the required goal contacts and end
+   * effector poses contained by goal_checker. CHOOSE samples from goal_sampler with probability goal_bias and from
+   * the sampler for choose otherwise. Without a goal region, the goal manifold is a box at the identity pose.
+   */
+  void setGoalRegion(std::shared_ptr<WorkspaceSampler> goal_sampler, std::shared_ptr<WorkspaceChecker> goal_checker,
+                     double goal_bias);
+
+  /* The collision constraints of the CHOOSE rollouts and of the revalidation of warm starts. All collisions are
+   * ignored by default.
+   */
+  void setCollisionTypes(std::shared_ptr<CollisionTypes> collision_types);
+
+  /* Sample the goal biased poses of CHOOSE from a scrambled Halton sequence per worker instead of independent
+   * uniform numbers, so that they cover the goal manifold evenly.
+   */
+  void setLowDiscrepancyGoalSampling(bool low_discrepancy);
+
+  /* Poses sampled by CHOOSE that reachability_checker does not contain are rejected without a rollout. */
+  void setReachabilityFilter(std::shared_ptr<WorkspaceChecker> reachability_checker);
+
+  /* Seed the random generator of CHOOSE, by default it is seeded with the time. With the same seed and number of
+   * choose controllers, CHOOSE returns the same configurations as long as no time limit is hit.
+   */
+  void setSeed(std::mt19937::result_type seed);
+
+  /* Limit the wall-clock time of solve. Zero means no limit. */
+  void setTimeBudget(double seconds);
+
+  /* Whether the last solve was stopped by its time budget. */
+  bool timeBudgetSpent() const
+  {
+    return time_budget_spent_;
+  }
+
+  /* The pose that the belief states are ranked by when no goal is admissible. */
+  void setGoalPose(const rl::math::Transform& goal_pose);
+
+  /* The belief means from the root of the tree to the best vertex of the last solve: the vertex admissible as goal,
+   * or if there is none, the vertex whose mean end effector pose is closest to the goal pose. Empty if there is no
+   * best vertex.
+   */
+  std::vector<rl::math::Vector> getBestPath() const;
+
+  /* The distance of the mean end effector pose of the best vertex to the goal pose, in metres plus a tenth of a metre
+   * per radian. Infinite if there is no best vertex.
+   */
+  rl::math::Real getBestGoalDistance() const
+  {
+    return best_goal_distance_;
+  }
+
+  const Statistics& getStatistics() const
+  {
+    return statistics_;
+  }
+
+  std::size_t getNumberOfVertices() const
+  {
+    return boost::num_vertices(tree[0]);
+  }
+
+  /* Continue the next solve from the tree of an earlier one in the same IFCO. It is used only if the start
+   * configuration is within delta of the root of the snapshot. Vertices whose particles touched a changed box are
+   * dropped, edges that come close to a changed box are rolled out again and dropped if they touch a changed box or no
+   * longer reach their vertex with its contacts. The subtrees of dropped vertices are dropped as well.
+   */
+  void setWarmStart(std::shared_ptr<const CerrtTreeSnapshot> snapshot,
+                    std::vector<CerrtTreeSnapshot::Box> changed_boxes);
+
+  /* The first tree of the last solve, without scene fingerprint and boxes. */
+  CerrtTreeSnapshot makeSnapshot() const;
 
 protected:
+  /* Sample poses and roll out to them from random tree vertices in parallel rounds, one rollout per worker and round,
+   * until a round finds a valid configuration. The other valid configurations of that round answer the next calls.
+   * Throws ChooseFailure when the budget is spent, the attempts are counted in whole rounds.
+   */
   void choose(rl::math::Vector& chosen) override;
+
+  /* Add the vertex to the tree and to the nearest neighbour index of the first tree. */
+  Vertex addVertex(Tree& tree, const rl::plan::VectorPtr& q) override;
+
+  /* Nearest vertex of the first tree from the kd-tree index, other trees are searched linearly. */
+  Neighbor nearest(const Tree& tree, const rl::math::Vector& chosen) override;
+
   void sampleInitialParticles(std::vector<rl::plan::Particle>& initialParticles) override;
   bool isAdmissableGoal(boost::shared_ptr<rl::plan::BeliefState> belief) override;
 
 private:
+  /* Thrown by choose when the time budget of solve is spent. */
+  class TimeBudgetSpent : public std::runtime_error
+  {
+  public:
+    TimeBudgetSpent() : std::runtime_error("The time budget of CERRT is spent")
+    {
+    }
+  };
+
+  /* The goal check without bookkeeping. */
+  bool checkGoal(rl::plan::BeliefState& belief);
+
+  /* The vertices from the root of the tree to the best vertex, empty if there is none. */
+  std::vector<Vertex> getBestPathVertices() const;
+
+  /* For every vertex of the warm start snapshot, whether it is still valid in the current scene. */
+  std::vector<bool> revalidateWarmStart();
+
+  /* Whether a rollout that ended in configuration reached a vertex at vertex_pose whose particles had vertex_contacts:
+   * the end effector is close to vertex_pose and the contacts at configuration are among those of the particles and
+   * include those all of them had.
+   */
+  bool reachesVertex(const rl::math::Vector& configuration, const rl::math::Transform& vertex_pose,
+                     const std::vector<std::vector<std::pair<std::string, std::string>>>& vertex_contacts);
+
+  /* Whether the robot at the configurations of an edge comes close to a changed box. */
+  bool nearChangedBox(const rl::math::Vector& from, const rl::math::Vector& to);
+
+  /* Add the valid vertices of the warm start snapshot below the root of the tree. */
+  void graftWarmStart(Vertex root);
+
   std::shared_ptr<JacobianController> jacobian_controller_;
   Viewer* viewer_;
   std::shared_ptr<WorkspaceSampler> sampler_for_choose_;
   std::shared_ptr<WorkspaceSampler> initial_sampler_;
-  std::unique_ptr<CollisionTypes> collision_types_;
-  std::unique_ptr<WorkspaceChecker> goal_checker_;
+  std::shared_ptr<CollisionTypes> collision_types_;
+  std::shared_ptr<WorkspaceChecker> goal_checker_;
+  std::shared_ptr<WorkspaceSampler> goal_sampler_;
+  double goal_bias_ = 0;
+  bool low_discrepancy_goal_sampling_ = false;
+  // the sequences of the goal biased poses of every worker in the current solve
+  std::vector<ScrambledHaltonSequence> goal_sequences_;
+  std::shared_ptr<WorkspaceChecker> reachability_checker_;
+
   std::unordered_set<std::pair<std::string, std::string>> required_goal_contacts_;
 
-  unsigned maximum_sample_attempts_ = 10;
+  // every required goal contact is interned as one bit of a mask
+  std::unordered_map<std::pair<std::string, std::string>, std::uint64_t> goal_contact_bits_;
+  std::uint64_t required_goal_mask_ = 0;
+  // end effector poses of the particles in isAdmissableGoal, kept to reuse the memory
+  std::vector<rl::math::Transform> particle_poses_;
+  rl::math::Vector particle_configuration_;
+
+  // the vertices of tree[0], indexed by their configurations
+  ConfigurationIndex<Vertex> vertex_index_;
+
+  std::shared_ptr<const CerrtTreeSnapshot> warm_start_;
+  std::vector<CerrtTreeSnapshot::Box> warm_start_changed_boxes_;
+  std::vector<bool> warm_start_valid_;
+  bool warm_start_pending_ = false;
+
+  std::vector<std::shared_ptr<JacobianController>> choose_controllers_;
+  // one worker per choose controller, worker i uses controller i
+  std::shared_ptr<WorkerPool> choose_pool_;
+  std::deque<rl::math::Vector> proposals_;
+  ChooseBudget choose_budget_;
+  bool choose_failed_ = false;
+
+  double time_budget_seconds_ = 0;
+  // the duration of rl::plan::Planner when the planner was created, used by solves without a time budget
+  std::chrono::steady_clock::duration default_duration_;
+  std::chrono::steady_clock::time_point solve_deadline_;
+  bool time_budget_spent_ = false;
+
+  boost::optional<rl::math::Transform> goal_pose_;
+  boost::shared_ptr<rl::plan::BeliefState> best_belief_;
+  bool best_belief_admissible_ = false;
+  rl::math::Real best_goal_distance_ = std::numeric_limits<rl::math::Real>::infinity();
+  Statistics statistics_;
   std::mt19937 random_gen_;
 };
 
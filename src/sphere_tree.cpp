@@ -0,0 +1,231 @@
+#include <algorithm>
+#include <stdexcept>
+#include <LinearMath/btConvexHullComputer.h>
+#include "sphere_tree.h"
+
+namespace
+{
+/* A lower bound of the distance of point from the shape of object, exact for boxes. */
+btScalar distanceBound(const btVector3& point, const btCollisionObject& object)
+{
+  auto shape = object.getCollisionShape();
+  if (shape->getShapeType() == BOX_SHAPE_PROXYTYPE)
+  {
+    btVector3 local = object.getWorldTransform().invXform(point);
+    btVector3 half_extents = static_cast<const btBoxShape*>(shape)->getHalfExtentsWithMargin();
+    btVector3 outside = (local.absolute() - half_extents);
+    outside.setMax(btVector3(0, 0, 0));
+    return outside.length();
+  }
+
+  btVector3 minimum, maximum;
+  shape->getAabb(object.getWorldTransform(), minimum, maximum);
+  btVector3 outside = (minimum - point);
+  outside.setMax(point - maximum);
+  outside.setMax(btVector3(0, 0, 0));
+  return outside.length();
+}
+}  // namespace
+
+SphereTree::SphereTree(const btAlignedObjectArray<btVector3>& points, int depth)
+{
+  btConvexHullComputer hull;
+  hull.compute(&points[0].getX(), sizeof(btVector3), points.size(), 0, 0);
+
+  // the slices are only bounded by their vertices if the edges crossing the cutting planes are known
+  if (hull.vertices.size() == 0 || hull.edges.size() == 0)
+  {
+    vertices_ = points;
+    depth = 0;
+  }
+  else
+  {
+    vertices_ = hull.vertices;
+    for (int i = 0; i < hull.edges.size(); ++i)
+    {
+      int source = hull.edges[i].getSourceVertex();
+      int target = hull.edges[i].getTargetVertex();
+      if (source < target)
+        edges_.push_back({ source, target });
+    }
+  }
+
+  btVector3 minimum = vertices_[0];
+  btVector3 maximum = vertices_[0];
+  for (int i = 1; i < vertices_.size(); ++i)
+  {
+    minimum.setMin(vertices_[i]);
+    maximum.setMax(vertices_[i]);
+  }
+
+  axis_ = btVector3(0, 0, 0);
+  axis_[(maximum - minimum).maxAxis()] = 1;
+
+  build(minimum.dot(axis_), maximum.dot(axis_), depth);
+}
+
+int SphereTree::build(btScalar lower, btScalar upper, int depth)
+{
+  btAlignedObjectArray<btVector3> part;
+  for (int i = 0; i < vertices_.size(); ++i)
+  {
+    btScalar t = vertices_[i].dot(axis_);
+    if (t >= lower && t <= upper)
+      part.push_back(vertices_[i]);
+  }
+
+  for (auto& edge : edges_)
+  {
+    const btVector3& u = vertices_[edge.first];
+    const btVector3& w = vertices_[edge.second];
+    btScalar tu = u.dot(axis_);
+    btScalar tw = w.dot(axis_);
+    for (btScalar plane : { lower, upper })
+    {
+      if ((tu - plane) * (tw - plane) < 0)
+        part.push_back(u + (w - u) * ((plane - tu) / (tw - tu)));
+    }
+  }
+
+  Node node;
+  node.children[0] = node.children[1] = -1;
+  if (part.size() == 0)
+  {
+    node.center = axis_ * ((lower + upper) / 2);
+    node.radius = 0;
+  }
+  else
+  {
+    btVector3 minimum = part[0];
+    btVector3 maximum = part[0];
+    for (int i = 1; i < part.size(); ++i)
+    {
+      minimum.setMin(part[i]);
+      maximum.setMax(part[i]);
+    }
+
+    node.center = (minimum + maximum) / 2;
+    node.radius = 0;
+    for (int i = 0; i < part.size(); ++i)
+      node.radius = std::max(node.radius, node.center.distance(part[i]));
+  }
+
+  int index = static_cast<int>(nodes_.size());
+  nodes_.push_back(node);
+
+  if (depth > 0)
+  {
+    btScalar middle = (lower + upper) / 2;
+    int first = build(lower, middle, depth - 1);
+    int second = build(middle, upper, depth - 1);
+    nodes_[index].children[0] = first;
+    nodes_[index].children[1] = second;
+  }
+
+  return index;
+}
+
+std::shared_ptr<const SphereTreeSet> SphereTreeSet::build(rl::sg::bullet::Scene& scene, int minimum_vertices,
+                                                          int depth)
+{
+  auto result = std::make_shared<SphereTreeSet>();
+  auto& objects = scene.world->getCollisionObjectArray();
+  result->objects_ = objects.size();
+  for (int i = 0; i < objects.size(); ++i)
+  {
+    auto shape = objects[i]->getCollisionShape();
+    if (!shape->isPolyhedral())
+      continue;
+
+    auto polyhedron = static_cast<const btPolyhedralConvexShape*>(shape);
+    if (polyhedron->getNumVertices() < minimum_vertices)
+      continue;
+
+    btAlignedObjectArray<btVector3> points;
+    points.resize(polyhedron->getNumVertices());
+    for (int j = 0; j < polyhedron->getNumVertices(); ++j)
+      polyhedron->getVertex(j, points[j]);
+
+    result->trees_.insert({ i, SphereTree(points, depth) });
+  }
+
+  return result;
+}
+
+SphereTreeTest::SphereTreeTest(rl::sg::bullet::Scene& scene, std::shared_ptr<const SphereTreeSet> trees)
+  : trees_(trees)
+{
+  auto& objects = scene.world->getCollisionObjectArray();
+  if (objects.size() != trees_->objects())
+    throw std::invalid_argument("The sphere trees were built for a scene with other collision objects");
+
+  for (int i = 0; i < objects.size(); ++i)
+  {
+    if (auto tree = trees_->find(i))
+      object_trees_.insert({ objects[i], tree });
+  }
+}
+
+SphereTreeTest::~SphereTreeTest()
+{
+}
+
+const SphereTree* SphereTreeTest::find(const btCollisionObject& object) const
+{
+  auto tree = object_trees_.find(&object);
+  return tree == object_trees_.end() ? nullptr : tree->second;
+}
+
+bool SphereTreeTest::separated(const btCollisionObject& a, const btCollisionObject& b)
+{
+  auto tree_a = find(a);
+  auto tree_b = find(b);
+  if (tree_a && tree_b)
+    return separated(*tree_a, 0, a, *tree_b, 0, b);
+  if (tree_a)
+    return separated(*tree_a, 0, a, b);
+  if (tree_b)
+    return separated(*tree_b, 0, b, a);
+
+  return false;
+}
+
+bool SphereTreeTest::separated(const SphereTree& tree, int node, const btCollisionObject& object,
+                               const btCollisionObject& other)
+{
+  auto& sphere = tree.nodes()[node];
+  btVector3 center = object.getWorldTransform()(sphere.center);
+  btScalar radius = sphere.radius + object.getCollisionShape()->getMargin();
+  if (distanceBound(center, other) - radius > gContactBreakingThreshold)
+    return true;
+
+  if (SphereTree::isLeaf(sphere))
+    return false;
+
+  return separated(tree, sphere.children[0], object, other) && separated(tree, sphere.children[1], object, other);
+}
+
+bool SphereTreeTest::separated(const SphereTree& tree_a, int node_a, const btCollisionObject& a,
+                               const SphereTree& tree_b, int node_b, const btCollisionObject& b)
+{
+  auto& sphere_a = tree_a.nodes()[node_a];
+  auto& sphere_b = tree_b.nodes()[node_b];
+  btVector3 center_a = a.getWorldTransform()(sphere_a.center);
+  btVector3 center_b = b.getWorldTransform()(sphere_b.center);
+  btScalar margins = a.getCollisionShape()->getMargin() + b.getCollisionShape()->getMargin();
+  if (center_a.distance(center_b) - sphere_a.radius - sphere_b.radius - margins > gContactBreakingThreshold)
+    return true;
+
+  bool leaf_a = SphereTree::isLeaf(sphere_a);
+  bool leaf_b = SphereTree::isLeaf(sphere_b);
+  if (leaf_a && leaf_b)
+    return false;
+
+  // descend into the larger sphere first, it shrinks the most
+  if (leaf_b || (!leaf_a && sphere_a.radius >= sphere_b.radius))
+    return separated(tree_a, sphere_a.children[0], a, tree_b, node_b, b) &&
+           separated(tree_a, sphere_a.children[1], a, tree_b, node_b, b);
+
+  return separated(tree_a, node_a, a, tree_b, sphere_b.children[0], b) &&
+         separated(tree_a, node_a, a, tree_b, sphere_b.children[1], b);
+}
@@ -0,0 +1,107 @@
+#ifndef SPHERE_TREE_H
+#define SPHERE_TREE_H
+
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include <btBulletCollisionCommon.h>
+#include <rl/sg/bullet/Scene.h>
+#include "collision_culling.h"
+
+/* A binary tree of spheres that bounds a convex hull, in the frame of its collision object. The hull is cut into
+ * slices along the axis of its largest extent, a leaf bounds one slice and an inner node the slices of its children.
+ * A sphere bounds the vertices of the hull inside its slices and the points where the hull edges cross the cutting
+ * planes, these are the vertices of the part of the hull in the slices, so every sphere contains its part and the
+ * tree stays conservative. The radii do not include the collision margin of the shape, which is added when testing,
+ * so that the tree stays conservative while the margin is grown.
+ */
+class SphereTree
+{
+public:
+  struct Node
+  {
+    btVector3 center;
+    btScalar radius;
+    // -1 for leaves
+    int children[2];
+  };
+
+  /* @param depth The depth of the leaves, the hull is cut into 2^depth slices. */
+  SphereTree(const btAlignedObjectArray<btVector3>& points, int depth);
+
+  /* The root is the first node. */
+  const std::vector<Node>& nodes() const
+  {
+    return nodes_;
+  }
+
+  static bool isLeaf(const Node& node)
+  {
+    return node.children[0] < 0;
+  }
+
+private:
+  int build(btScalar lower, btScalar upper, int depth);
+
+  btAlignedObjectArray<btVector3> vertices_;
+  std::vector<std::pair<int, int>> edges_;
+  btVector3 axis_;
+  std::vector<Node> nodes_;
+};
+
+/* The sphere trees of the polyhedral shapes of a scene with at least minimum_vertices vertices, the link hulls of the
+ * robot, smaller shapes are tested faster by bullet itself. The trees are in the frames of the collision objects and
+ * found by the index of their object in the scene they were built from. Scenes loaded from the same files have the
+ * same objects in the same order, so they can share the trees.
+ */
+class SphereTreeSet
+{
+public:
+  /* @param depth The depth of the leaves of every tree. */
+  static std::shared_ptr<const SphereTreeSet> build(rl::sg::bullet::Scene& scene, int minimum_vertices = 32,
+                                                    int depth = 3);
+
+  /* The tree of the collision object with index object, or nullptr if it has none. */
+  const SphereTree* find(int object) const
+  {
+    auto tree = trees_.find(object);
+    return tree == trees_.end() ? nullptr : &tree->second;
+  }
+
+  /* The number of collision objects of the scene the trees were built from. */
+  int objects() const
+  {
+    return objects_;
+  }
+
+private:
+  int objects_ = 0;
+  std::unordered_map<int, SphereTree> trees_;
+};
+
+/* Rejects the pairs of a collision object with a sphere tree that are apart before bullet runs its narrow phase. The
+ * other object of a pair is bounded by its oriented box if it is a box and by its bounding box otherwise, or by its
+ * own tree. A pair is apart if each leaf of the tree is apart, descending stops at the first node whose sphere is.
+ */
+class SphereTreeTest : public CollisionCulling::Test
+{
+public:
+  /* @param trees The trees of a scene loaded from the same files as scene, with the same collision objects. */
+  SphereTreeTest(rl::sg::bullet::Scene& scene, std::shared_ptr<const SphereTreeSet> trees);
+  ~SphereTreeTest() override;
+
+  bool separated(const btCollisionObject& a, const btCollisionObject& b) override;
+
+  /* The tree of object, or nullptr if it has none. */
+  const SphereTree* find(const btCollisionObject& object) const;
+
+private:
+  bool separated(const SphereTree& tree, int node, const btCollisionObject& object, const btCollisionObject& other);
+  bool separated(const SphereTree& tree_a, int node_a, const btCollisionObject& a, const SphereTree& tree_b,
+                 int node_b, const btCollisionObject& b);
+
+  std::shared_ptr<const SphereTreeSet> trees_;
+  std::unordered_map<const btCollisionObject*, const SphereTree*> object_trees_;
+};
+
+#endif  // SPHERE_TREE_H
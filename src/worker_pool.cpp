@@ -0,0 +1,86 @@
+#include "worker_pool.h"
+
+WorkerPool::WorkerPool(std::size_t number_of_workers)
+{
+  for (std::size_t i = 1; i < number_of_workers; ++i)
+    threads_.emplace_back(&WorkerPool::work, this, i);
+}
+
+WorkerPool::~WorkerPool()
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  task_ready_.notify_all();
+
+  for (auto& thread : threads_)
+    thread.join();
+}
+
+void WorkerPool::run(const std::function<void(std::size_t)>& task)
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    task_ = &task;
+    ++generation_;
+    running_ = threads_.size();
+    exception_ = nullptr;
+  }
+  task_ready_.notify_all();
+
+  std::exception_ptr own_exception;
+  try
+  {
+    task(0);
+  }
+  catch (...)
+  {
+    own_exception = std::current_exception();
+  }
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  task_done_.wait(lock, [this] { return running_ == 0; });
+  task_ = nullptr;
+
+  if (own_exception)
+    std::rethrow_exception(own_exception);
+  if (exception_)
+    std::rethrow_exception(exception_);
+}
+
+void WorkerPool::work(std::size_t worker)
+{
+  std::size_t done_generation = 0;
+  while (true)
+  {
+    const std::function<void(std::size_t)>* task;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      task_ready_.wait(lock, [&] { return stopping_ || generation_ != done_generation; });
+      if (stopping_)
+        return;
+
+      done_generation = generation_;
+      task = task_;
+    }
+
+    std::exception_ptr exception;
+    try
+    {
+      (*task)(worker);
+    }
+    catch (...)
+    {
+      exception = std::current_exception();
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (exception && !exception_)
+        exception_ = exception;
+      --running_;
+    }
+    task_done_.notify_one();
+  }
+}
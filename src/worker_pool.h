@@ -0,0 +1,50 @@
+#ifndef WORKER_POOL_H
+#define WORKER_POOL_H
+
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/* A fixed set of threads that run one task together. run hands the task to every worker with the index of the
+ * worker and returns when all of them are done, so threads are started once instead of once per task.
+ */
+class WorkerPool
+{
+public:
+  /* @param number_of_workers The number of tasks run in parallel. The calling thread of run is worker 0, only the
+   * other workers get threads of their own.
+   */
+  explicit WorkerPool(std::size_t number_of_workers);
+  ~WorkerPool();
+
+  WorkerPool(const WorkerPool&) = delete;
+  WorkerPool& operator=(const WorkerPool&) = delete;
+
+  /* Run task(worker) for every worker and wait for all of them. The first exception thrown by a task is rethrown. */
+  void run(const std::function<void(std::size_t)>& task);
+
+  std::size_t size() const
+  {
+    return threads_.size() + 1;
+  }
+
+private:
+  void work(std::size_t worker);
+
+  std::vector<std::thread> threads_;
+  std::mutex mutex_;
+  std::condition_variable task_ready_;
+  std::condition_variable task_done_;
+
+  const std::function<void(std::size_t)>* task_ = nullptr;
+  // incremented for every task, a worker runs a task once
+  std::size_t generation_ = 0;
+  std::size_t running_ = 0;
+  std::exception_ptr exception_;
+  bool stopping_ = false;
+};
+
+#endif  // WORKER_POOL_H
@@ -1,3 +1,4 @@
+#include <cmath>
 #include "workspace_checkers.h"
 
 WorkspaceChecker::~WorkspaceChecker()
@@ -10,15 +11,55 @@ BoxChecker::~BoxChecker()
 
 }
 
+DeltaBoxChecker::~DeltaBoxChecker()
+{
+
+}
+
+SphereChecker::~SphereChecker()
+{
+
+}
+
+bool WorkspaceChecker::containsAll(const std::vector<rl::math::Transform>& transforms) const
+{
+  for (auto& transform : transforms)
+    if (!contains(transform))
+      return false;
+
+  return true;
+}
+
 bool BoxChecker::contains(const rl::math::Transform &transform) const
 {
-  using namespace rl::math;
+  return containsPosition(transform) && containsOrientation(transform);
+}
+
+bool BoxChecker::containsAll(const std::vector<rl::math::Transform>& transforms) const
+{
+  for (auto& transform : transforms)
+    if (!containsPosition(transform))
+      return false;
+
+  for (auto& transform : transforms)
+    if (!containsOrientation(transform))
+      return false;
+
+  return true;
+}
 
+bool BoxChecker::containsPosition(const rl::math::Transform& transform) const
+{
   Eigen::Array3d position_difference = (transform.translation() - center_pose_.translation()).array().abs();
   for (std::size_t i = 0; i < 3; ++i)
     if (position_difference(i) > dimensions_[i] / 2)
       return false;
 
+  return true;
+}
+
+bool BoxChecker::containsOrientation(const rl::math::Transform& transform) const
+{
   Eigen::Matrix3d rotation_difference = center_pose_.linear() * transform.linear().transpose();
   Eigen::Array3d XYZ_euler_angles = rotation_difference.eulerAngles(0, 1, 2).array().abs();
   for (std::size_t i = 0; i < 3; i++)
@@ -27,3 +68,41 @@ bool BoxChecker::contains(const rl::math::Transform &transform) const
 
   return true;
 }
+
+bool DeltaBoxChecker::contains(const rl::math::Transform& transform) const
+{
+  Eigen::Vector3d position_delta = transform.translation() - goal_pose_.translation();
+  for (std::size_t i = 0; i < 3; ++i)
+    if (position_delta(i) < min_position_deltas_[i] || position_delta(i) > max_position_deltas_[i])
+      return false;
+
+  // the sampler rotates the goal orientation by Rz(c) * Ry(b) * Rx(a), eulerAngles(2, 1, 0) returns (c, b, a)
+  Eigen::Matrix3d rotation_delta = transform.linear() * goal_pose_.linear().transpose();
+  Eigen::Vector3d zyx_angles = rotation_delta.eulerAngles(2, 1, 0);
+
+  // every rotation has a second set of angles, (c + pi, pi - b, a + pi), and the deltas may lie in either
+  const double pi = M_PI;
+  std::array<Eigen::Vector3d, 2> solutions = { zyx_angles,
+                                               Eigen::Vector3d(zyx_angles(0) + pi, pi - zyx_angles(1),
+                                                               zyx_angles(2) + pi) };
+  for (auto& solution : solutions)
+  {
+    if (containsAngle(solution(2), 0) && containsAngle(solution(1), 1) && containsAngle(solution(0), 2))
+      return true;
+  }
+
+  return false;
+}
+
+bool DeltaBoxChecker::containsAngle(double angle, std::size_t axis) const
+{
+  // the smallest angle equal to angle up to full turns that is not below the minimum
+  double turns = std::ceil((min_orientation_deltas_[axis] - angle) / (2 * M_PI));
+  return angle + turns * 2 * M_PI <= max_orientation_deltas_[axis];
+}
+
+bool SphereChecker::contains(const rl::math::Transform& transform) const
+{
+  auto squared_distance = (transform.translation() - center_).squaredNorm();
+  return squared_distance <= maximum_radius_ * maximum_radius_ && squared_distance >= minimum_radius_ * minimum_radius_;
+}
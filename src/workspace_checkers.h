@@ -1,7 +1,9 @@
 #ifndef WORKSPACE_CHECKERS_H
 #define WORKSPACE_CHECKERS_H
 
+#include <vector>
 #include <rl/math/Transform.h>
+#include <rl/math/Vector.h>
 
 /* Checks whether a pose is contained within a workspace manifold. */
 class WorkspaceChecker
@@ -9,6 +11,9 @@ class WorkspaceChecker
 public:
   virtual ~WorkspaceChecker();
   virtual bool contains(const rl::math::Transform& transform) const = 0;
+
+  /* Whether every pose is contained. Stops at the first pose that is not. */
+  virtual bool containsAll(const std::vector<rl::math::Transform>& transforms) const;
 };
 
 /* A manifold with positions inside of a box and orientations having a maximum value of Euler XYZ rotation. */
@@ -25,11 +30,71 @@ public:
 
   bool contains(const rl::math::Transform& transform) const override;
 
+  /* Checks the cheap position constraint of all poses before computing any Euler angles. */
+  bool containsAll(const std::vector<rl::math::Transform>& transforms) const override;
+
 private:
+  bool containsPosition(const rl::math::Transform& transform) const;
+  bool containsOrientation(const rl::math::Transform& transform) const;
+
   rl::math::Transform center_pose_;
   std::array<double, 3> dimensions_;
   // TODO i don't think this will work as expected. do not know the theory that will help make it better
   std::array<double, 3> maximum_abs_XYZ_angles_;
 };
 
+/* The manifold DeltaBoxSampler samples from: positions whose deltas from the goal position lie between the minimum and
+ * maximum position deltas, and orientations goal_pose rotated by Rz(c) * Ry(b) * Rx(a), the same convention as the
+ * sampler, with (a, b, c) between the minimum and maximum orientation deltas.
+ */
+class DeltaBoxChecker : public WorkspaceChecker
+{
+public:
+  DeltaBoxChecker(const rl::math::Transform& goal_pose, std::array<double, 3> min_position_deltas,
+                  std::array<double, 3> max_position_deltas, std::array<double, 3> min_orientation_deltas,
+                  std::array<double, 3> max_orientation_deltas)
+    : goal_pose_(goal_pose)
+    , min_position_deltas_(min_position_deltas)
+    , max_position_deltas_(max_position_deltas)
+    , min_orientation_deltas_(min_orientation_deltas)
+    , max_orientation_deltas_(max_orientation_deltas)
+  {
+  }
+
+  ~DeltaBoxChecker() override;
+
+  bool contains(const rl::math::Transform& transform) const override;
+
+private:
+  /* Whether angle, up to full turns, lies between the minimum and maximum orientation delta of axis. */
+  bool containsAngle(double angle, std::size_t axis) const;
+
+  rl::math::Transform goal_pose_;
+  std::array<double, 3> min_position_deltas_;
+  std::array<double, 3> max_position_deltas_;
+  std::array<double, 3> min_orientation_deltas_;
+  std::array<double, 3> max_orientation_deltas_;
+};
+
+/* A manifold with positions inside of a sphere shell and any orientation. Used as a cheap estimate of the positions
+ * the end effector can reach.
+ */
+class SphereChecker : public WorkspaceChecker
+{
+public:
+  SphereChecker(const rl::math::Vector3& center, double maximum_radius, double minimum_radius = 0)
+    : center_(center), maximum_radius_(maximum_radius), minimum_radius_(minimum_radius)
+  {
+  }
+
+  ~SphereChecker() override;
+
+  bool contains(const rl::math::Transform& transform) const override;
+
+private:
+  rl::math::Vector3 center_;
+  double maximum_radius_;
+  double minimum_radius_;
+};
+
 #endif  // WORKSPACE_CHECKERS_H
@@ -1,4 +1,5 @@
 #include <Eigen/Geometry>
+#include <boost/assert.hpp>
 #include "jacobian_controller.h"
 #include "workspace_samplers.h"
 
@@ -9,12 +10,90 @@ WorkspaceSampler::~WorkspaceSampler()
 
 }
 
+void PoseBatch::resize(std::size_t size)
+{
+  for (auto coordinates : { &x, &y, &z, &qw, &qx, &qy, &qz })
+    coordinates->resize(size);
+}
+
+Transform PoseBatch::transform(std::size_t i) const
+{
+  Transform result = Transform::Identity();
+  result.translation() = Vector3(x[i], y[i], z[i]);
+  result.linear() = Quaternion(qw[i], qx[i], qy[i], qz[i]).toRotationMatrix();
+  return result;
+}
+
+Transform WorkspaceSampler::generateFromSequence(UnitCubeSequence& sequence)
+{
+  BOOST_ASSERT_MSG(sequence.dimensions() == 6, "Poses are generated from 6-dimensional sequences");
+
+  std::array<double, 6> point;
+  sequence.next(point.data());
+
+  Transform result = Transform::Identity();
+  result.translation() = generatePosition({ point[0], point[1], point[2] });
+  result.linear() = generateOrientation({ point[3], point[4], point[5] }).matrix();
+  return result;
+}
+
+void WorkspaceSampler::generatePositions(const double* randoms_0, const double* randoms_1, const double* randoms_2,
+                                         PoseBatch& batch)
+{
+  for (std::size_t i = 0; i < batch.size(); ++i)
+  {
+    Vector position = generatePosition({ randoms_0[i], randoms_1[i], randoms_2[i] });
+    batch.x[i] = position(0);
+    batch.y[i] = position(1);
+    batch.z[i] = position(2);
+  }
+}
+
+void WorkspaceSampler::generateOrientations(const double* randoms_0, const double* randoms_1,
+                                            const double* randoms_2, PoseBatch& batch)
+{
+  for (std::size_t i = 0; i < batch.size(); ++i)
+  {
+    auto orientation = generateOrientation({ randoms_0[i], randoms_1[i], randoms_2[i] });
+    batch.qw[i] = orientation.w();
+    batch.qx[i] = orientation.x();
+    batch.qy[i] = orientation.y();
+    batch.qz[i] = orientation.z();
+  }
+}
+
 Quaternion UniformOrientationSampler::generateOrientation(std::array<double, 3> randoms_01)
 {
   // source http://planning.cs.uiuc.edu/node198.html
   auto& u = randoms_01;
-  return Quaternion(sqrt(u[0]) * cos(M_2_PI * u[2]), sqrt(1 - u[0]) * sin(M_2_PI * u[1]),
-                    sqrt(1 - u[0]) * cos(M_2_PI * u[1]), sqrt(u[0]) * sin(M_2_PI * u[2]));
+  const double two_pi = 2 * M_PI;
+  return Quaternion(sqrt(u[0]) * cos(two_pi * u[2]), sqrt(1 - u[0]) * sin(two_pi * u[1]),
+                    sqrt(1 - u[0]) * cos(two_pi * u[1]), sqrt(u[0]) * sin(two_pi * u[2]));
+}
+
+void UniformOrientationSampler::generateOrientations(const double* __restrict__ randoms_0,
+                                                     const double* __restrict__ randoms_1,
+                                                     const double* __restrict__ randoms_2, PoseBatch& batch)
+{
+  // the same formula as generateOrientation, as loops without dependencies between the poses
+  const double two_pi = 2 * M_PI;
+  const std::size_t size = batch.size();
+  double* __restrict__ qw = batch.qw.data();
+  double* __restrict__ qx = batch.qx.data();
+  double* __restrict__ qy = batch.qy.data();
+  double* __restrict__ qz = batch.qz.data();
+
+  for (std::size_t i = 0; i < size; ++i)
+  {
+    double r_1 = std::sqrt(1 - randoms_0[i]);
+    double r_2 = std::sqrt(randoms_0[i]);
+    double angle_1 = two_pi * randoms_1[i];
+    double angle_2 = two_pi * randoms_2[i];
+    qw[i] = r_2 * std::cos(angle_2);
+    qx[i] = r_1 * std::sin(angle_1);
+    qy[i] = r_1 * std::cos(angle_1);
+    qz[i] = r_2 * std::sin(angle_2);
+  }
 }
 
 Vector BoxUniformOrientationSampler::generatePosition(std::array<double, 3> randoms_01)
@@ -25,3 +104,60 @@ Vector BoxUniformOrientationSampler::generatePosition(std::array<double, 3> rand
 
   return box_pose_ * point;
 }
+
+void BoxUniformOrientationSampler::generatePositions(const double* __restrict__ randoms_0,
+                                                     const double* __restrict__ randoms_1,
+                                                     const double* __restrict__ randoms_2, PoseBatch& batch)
+{
+  // the box pose applied to the points in the box frame, written out per coordinate
+  const std::size_t size = batch.size();
+  const Matrix33 rotation = box_pose_.linear();
+  const Vector3 translation = box_pose_.translation();
+  double* __restrict__ x = batch.x.data();
+  double* __restrict__ y = batch.y.data();
+  double* __restrict__ z = batch.z.data();
+
+  for (std::size_t i = 0; i < size; ++i)
+  {
+    double local_x = (randoms_0[i] - 0.5) * dimensions_[0];
+    double local_y = (randoms_1[i] - 0.5) * dimensions_[1];
+    double local_z = (randoms_2[i] - 0.5) * dimensions_[2];
+    x[i] = translation(0) + rotation(0, 0) * local_x + rotation(0, 1) * local_y + rotation(0, 2) * local_z;
+    y[i] = translation(1) + rotation(1, 0) * local_x + rotation(1, 1) * local_y + rotation(1, 2) * local_z;
+    z[i] = translation(2) + rotation(2, 0) * local_x + rotation(2, 1) * local_y + rotation(2, 2) * local_z;
+  }
+}
+
+Quaternion DeltaBoxSampler::generateOrientation(std::array<double, 3> randoms_01)
+{
+  std::array<double, 3> angles;
+  for (int i = 0; i < 3; ++i)
+    angles[i] = min_orientation_deltas_[i] + randoms_01[i] * (max_orientation_deltas_[i] - min_orientation_deltas_[i]);
+
+  Matrix33 rotation = AngleAxis(angles[2], Vector3::UnitZ()) * AngleAxis(angles[1], Vector3::UnitY()) *
+                      AngleAxis(angles[0], Vector3::UnitX()) * goal_pose_.linear();
+  return Quaternion(rotation);
+}
+
+std::array<double, 3> DeltaBoxSampler::orientationDeltas(const Transform& pose) const
+{
+  // eulerAngles returns (c, b, a) with c in [0, pi], the other set of angles of the rotation has b in [-pi/2, pi/2]
+  Vector3 zyx_angles = (pose.linear() * goal_pose_.linear().transpose()).eulerAngles(2, 1, 0);
+  if (std::abs(zyx_angles(1)) > M_PI / 2)
+    zyx_angles = Vector3(zyx_angles(0) - M_PI, M_PI - zyx_angles(1), zyx_angles(2) - M_PI);
+
+  std::array<double, 3> deltas;
+  for (int i = 0; i < 3; ++i)
+    deltas[i] = std::remainder(zyx_angles(2 - i), 2 * M_PI);
+
+  return deltas;
+}
+
+Vector DeltaBoxSampler::generatePosition(std::array<double, 3> randoms_01)
+{
+  Vector3 point = goal_pose_.translation();
+  for (int i = 0; i < 3; ++i)
+    point(i) += min_position_deltas_[i] + randoms_01[i] * (max_position_deltas_[i] - min_position_deltas_[i]);
+
+  return point;
+}
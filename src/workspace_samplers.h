@@ -3,19 +3,61 @@
 
 #include <random>
 #include <cmath>
+#include <vector>
 #include <rl/math/Vector.h>
 #include <rl/math/Transform.h>
 #include <boost/optional.hpp>
 #include "collision_types.h"
 #include "jacobian_controller.h"
+#include "low_discrepancy.h"
 
 // TODO in dire need of rework. Have not figured out a way to write it cleanly so far.
 
+/* Poses stored as arrays of their coordinates, pose i is made of element i of every array. */
+struct PoseBatch
+{
+  std::vector<double> x, y, z;
+  // the orientations as unit quaternions
+  std::vector<double> qw, qx, qy, qz;
+  // the random numbers the poses were generated from, kept to reuse the memory
+  std::vector<double> randoms;
+
+  void resize(std::size_t size);
+
+  std::size_t size() const
+  {
+    return x.size();
+  }
+
+  rl::math::Transform transform(std::size_t i) const;
+};
+
 class WorkspaceSampler
 {
 public:
   virtual ~WorkspaceSampler();
 
+  /* Generate a pose from the next point of a 6-dimensional sequence, the first three coordinates give the position
+   * and the last three the orientation.
+   */
+  rl::math::Transform generateFromSequence(UnitCubeSequence& sequence);
+
+  /* Generate size poses into batch. The random numbers are drawn for all positions first, then for all orientations,
+   * so the poses differ from those of size calls of generate with the same engine.
+   */
+  template <class RandomEngine> void generateBatch(RandomEngine& engine, std::size_t size, PoseBatch& batch)
+  {
+    std::uniform_real_distribution<double> random_01;
+    batch.randoms.resize(6 * size);
+    for (auto& random : batch.randoms)
+      random = random_01(engine);
+
+    batch.resize(size);
+    auto randoms = batch.randoms.data();
+    generatePositions(randoms, randoms + size, randoms + 2 * size, batch);
+    generateOrientations(randoms + 3 * size, randoms + 4 * size, randoms + 5 * size, batch);
+  }
+
   template <class RandomEngine> rl::math::Transform generate(RandomEngine& engine)
   {
     auto result = rl::math::Transform::Identity();
@@ -38,12 +80,23 @@ public:
 protected:
   virtual rl::math::Quaternion generateOrientation(std::array<double, 3> randoms_01) = 0;
   virtual rl::math::Vector generatePosition(std::array<double, 3> randoms_01) = 0;
+
+  /* Batch versions of generatePosition and generateOrientation, the random numbers of pose i are element i of the
+   * three arrays. By default they call the single versions for every pose.
+   */
+  virtual void generatePositions(const double* randoms_0, const double* randoms_1, const double* randoms_2,
+                                 PoseBatch& batch);
+  virtual void generateOrientations(const double* randoms_0, const double* randoms_1, const double* randoms_2,
+                                    PoseBatch& batch);
 };
 
+/* Orientations uniformly distributed over SO(3). */
 class UniformOrientationSampler : public WorkspaceSampler
 {
 protected:
   rl::math::Quaternion generateOrientation(std::array<double, 3> randoms_01) override;
+  void generateOrientations(const double* randoms_0, const double* randoms_1, const double* randoms_2,
+                            PoseBatch& batch) override;
 };
 
 class BoxUniformOrientationSampler : public UniformOrientationSampler
@@ -56,12 +109,48 @@ public:
 
 protected:
   rl::math::Vector generatePosition(std::array<double, 3> randoms_01) override;
+  void generatePositions(const double* randoms_0, const double* randoms_1, const double* randoms_2,
+                         PoseBatch& batch) override;
 
 private:
   rl::math::Transform box_pose_;
   std::array<double, 3> dimensions_;
 };
 
+/* Poses around a goal pose, with position deltas and XYZ Euler angle deltas uniform within their ranges. The deltas
+ * are applied as in the sampling of the CheckKinematics service.
+ */
+class DeltaBoxSampler : public WorkspaceSampler
+{
+public:
+  DeltaBoxSampler(const rl::math::Transform& goal_pose, std::array<double, 3> min_position_deltas,
+                  std::array<double, 3> max_position_deltas, std::array<double, 3> min_orientation_deltas,
+                  std::array<double, 3> max_orientation_deltas)
+    : goal_pose_(goal_pose)
+    , min_position_deltas_(min_position_deltas)
+    , max_position_deltas_(max_position_deltas)
+    , min_orientation_deltas_(min_orientation_deltas)
+    , max_orientation_deltas_(max_orientation_deltas)
+  {
+  }
+
+  /* The orientation deltas (a, b, c) of pose, with the orientation of pose Rz(c) * Ry(b) * Rx(a) times the goal
+   * orientation like the generated ones. b is in [-pi/2, pi/2], a and c in [-pi, pi].
+   */
+  std::array<double, 3> orientationDeltas(const rl::math::Transform& pose) const;
+
+protected:
+  rl::math::Quaternion generateOrientation(std::array<double, 3> randoms_01) override;
+  rl::math::Vector generatePosition(std::array<double, 3> randoms_01) override;
+
+private:
+  rl::math::Transform goal_pose_;
+  std::array<double, 3> min_position_deltas_;
+  std::array<double, 3> max_position_deltas_;
+  std::array<double, 3> min_orientation_deltas_;
+  std::array<double, 3> max_orientation_deltas_;
+};
+
 // TODO this is not usable anymore due to the number of parameters
 // maybe it is easier just to write this code explicitly in Concerrt though!
 template <class RandomEngine>
@@ -0,0 +1,96 @@
+#define BOOST_TEST_MODULE test_configuration_index
+
+#include <boost/test/included/unit_test.hpp>
+#include <random>
+#include "configuration_index.h"
+
+namespace
+{
+/* The nearest configuration by exhaustive search, the reference for the kd-tree. */
+std::pair<int, rl::math::Real> bruteForceNearest(const std::vector<rl::math::Vector>& configurations,
+                                                 const std::vector<int>& values, const rl::math::Vector& query)
+{
+  std::pair<int, rl::math::Real> best(-1, std::numeric_limits<rl::math::Real>::infinity());
+  for (std::size_t i = 0; i < configurations.size(); ++i)
+  {
+    auto distance = (configurations[i] - query).norm();
+    if (distance < best.second)
+      best = { values[i], distance };
+  }
+
+  return best;
+}
+
+rl::math::Vector randomConfiguration(std::mt19937& engine, int dof)
+{
+  std::uniform_real_distribution<rl::math::Real> uniform(-3, 3);
+  rl::math::Vector configuration(dof);
+  for (int i = 0; i < dof; ++i)
+    configuration(i) = uniform(engine);
+
+  return configuration;
+}
+}  // namespace
+
+BOOST_AUTO_TEST_CASE(empty_index)
+{
+  ConfigurationIndex<int> index;
+  BOOST_CHECK(index.empty());
+  BOOST_CHECK_EQUAL(index.size(), 0u);
+}
+
+BOOST_AUTO_TEST_CASE(nearest_matches_brute_force)
+{
+  std::mt19937 engine(1);
+  ConfigurationIndex<int> index;
+  std::vector<rl::math::Vector> configurations;
+  std::vector<int> values;
+  for (int i = 0; i < 500; ++i)
+  {
+    configurations.push_back(randomConfiguration(engine, 7));
+    values.push_back(i);
+    index.insert(configurations.back(), i);
+  }
+
+  BOOST_CHECK_EQUAL(index.size(), 500u);
+  for (int i = 0; i < 200; ++i)
+  {
+    auto query = randomConfiguration(engine, 7);
+    auto expected = bruteForceNearest(configurations, values, query);
+    auto found = index.nearest(query);
+    BOOST_CHECK_EQUAL(found.first, expected.first);
+    BOOST_CHECK_CLOSE(found.second, expected.second, 1e-9);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(nearest_of_an_inserted_configuration_is_itself)
+{
+  std::mt19937 engine(2);
+  ConfigurationIndex<int> index;
+  std::vector<rl::math::Vector> configurations;
+  for (int i = 0; i < 100; ++i)
+  {
+    configurations.push_back(randomConfiguration(engine, 3));
+    index.insert(configurations.back(), i);
+  }
+
+  for (int i = 0; i < 100; ++i)
+  {
+    auto found = index.nearest(configurations[i]);
+    BOOST_CHECK_EQUAL(found.first, i);
+    BOOST_CHECK_SMALL(found.second, 1e-12);
+    BOOST_CHECK_EQUAL(index[i], i);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(clear_empties_the_index)
+{
+  ConfigurationIndex<int> index;
+  index.insert(rl::math::Vector::Zero(2), 1);
+  index.clear();
+  BOOST_CHECK(index.empty());
+
+  // a cleared index is usable again
+  index.insert(rl::math::Vector::Ones(2), 2);
+  BOOST_CHECK_EQUAL(index.nearest(rl::math::Vector::Zero(2)).first, 2);
+}
@@ -0,0 +1,150 @@
+#define BOOST_TEST_MODULE test_low_discrepancy
+
+#include <boost/test/included/unit_test.hpp>
+#include <cmath>
+#include <set>
+#include <stdexcept>
+#include "low_discrepancy.h"
+
+namespace
+{
+std::size_t greatestCommonDivisor(std::size_t a, std::size_t b)
+{
+  return b == 0 ? a : greatestCommonDivisor(b, a % b);
+}
+
+/* The number of the first count points of sequence in each of cells equal intervals of dimension. */
+std::vector<std::size_t> countPerCell(UnitCubeSequence& sequence, std::size_t dimension, std::size_t count,
+                                      std::size_t cells)
+{
+  std::vector<std::size_t> counts(cells, 0);
+  std::vector<double> point(sequence.dimensions());
+  for (std::size_t i = 0; i < count; ++i)
+  {
+    sequence.next(point.data());
+    ++counts[static_cast<std::size_t>(point[dimension] * cells)];
+  }
+
+  return counts;
+}
+}  // namespace
+
+BOOST_AUTO_TEST_CASE(halton_points_lie_in_the_unit_cube)
+{
+  ScrambledHaltonSequence sequence(6, 1);
+  std::vector<double> point(6);
+  for (int i = 0; i < 1000; ++i)
+  {
+    sequence.next(point.data());
+    for (auto value : point)
+    {
+      BOOST_CHECK_GE(value, 0);
+      BOOST_CHECK_LT(value, 1);
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(halton_is_deterministic_per_seed)
+{
+  ScrambledHaltonSequence a(3, 7), b(3, 7), c(3, 8);
+  std::vector<double> point_a(3), point_b(3), point_c(3);
+  bool differs = false;
+  for (int i = 0; i < 20; ++i)
+  {
+    a.next(point_a.data());
+    b.next(point_b.data());
+    c.next(point_c.data());
+    BOOST_CHECK(point_a == point_b);
+    differs = differs || point_a != point_c;
+  }
+
+  BOOST_CHECK(differs);
+}
+
+BOOST_AUTO_TEST_CASE(halton_gives_the_small_primes_to_active_dimensions)
+{
+  ScrambledHaltonSequence sequence({ false, false, true, false, true, true }, 1);
+  BOOST_CHECK_EQUAL(sequence.base(0), 0u);
+  BOOST_CHECK_EQUAL(sequence.base(1), 0u);
+  BOOST_CHECK_EQUAL(sequence.base(2), 2u);
+  BOOST_CHECK_EQUAL(sequence.base(3), 0u);
+  BOOST_CHECK_EQUAL(sequence.base(4), 3u);
+  BOOST_CHECK_EQUAL(sequence.base(5), 5u);
+
+  std::vector<double> point(6);
+  sequence.next(point.data());
+  BOOST_CHECK_EQUAL(point[0], 0.5);
+  BOOST_CHECK_EQUAL(point[1], 0.5);
+  BOOST_CHECK_EQUAL(point[3], 0.5);
+}
+
+BOOST_AUTO_TEST_CASE(halton_stratifies_every_active_dimension)
+{
+  // the shift moves the points of a full period of the base by the same amount, at most one crosses into a
+  // neighbouring interval
+  ScrambledHaltonSequence sequence({ false, true, true }, 3);
+  for (auto count : countPerCell(sequence, 1, 64, 8))
+    BOOST_CHECK(count >= 7 && count <= 9);
+
+  ScrambledHaltonSequence other({ false, true, true }, 3);
+  for (auto count : countPerCell(other, 2, 81, 9))
+    BOOST_CHECK(count >= 8 && count <= 10);
+}
+
+BOOST_AUTO_TEST_CASE(halton_rejects_more_than_16_active_dimensions)
+{
+  BOOST_CHECK_THROW(ScrambledHaltonSequence(17, 1), std::invalid_argument);
+
+  std::vector<bool> active_dimensions(20, true);
+  for (std::size_t i = 0; i < 4; ++i)
+    active_dimensions[i] = false;
+  BOOST_CHECK_NO_THROW(ScrambledHaltonSequence(active_dimensions, 1));
+}
+
+BOOST_AUTO_TEST_CASE(grid_visits_every_cell_once)
+{
+  for (std::size_t count : { 1, 2, 7, 12, 20, 64, 100 })
+  {
+    StratifiedGridSequence sequence({ true, false, true, true, false, false }, count, 1);
+    BOOST_CHECK_LE(sequence.numberOfCells(), count);
+    BOOST_CHECK_EQUAL(greatestCommonDivisor(sequence.stride(), sequence.numberOfCells()), 1u);
+
+    std::set<std::vector<double>> points;
+    std::vector<double> point(6);
+    for (std::size_t i = 0; i < sequence.numberOfCells(); ++i)
+    {
+      sequence.next(point.data());
+      BOOST_CHECK_EQUAL(point[1], 0.5);
+      BOOST_CHECK_EQUAL(point[4], 0.5);
+      BOOST_CHECK_EQUAL(point[5], 0.5);
+      points.insert(point);
+    }
+
+    BOOST_CHECK_EQUAL(points.size(), sequence.numberOfCells());
+  }
+}
+
+BOOST_AUTO_TEST_CASE(grid_splits_the_active_dimensions_evenly)
+{
+  StratifiedGridSequence sequence({ true, true, false }, 20, 1);
+  // 4 x 5 cells
+  BOOST_CHECK_EQUAL(sequence.numberOfCells(), 20u);
+}
+
+BOOST_AUTO_TEST_CASE(grid_continues_with_halton_points)
+{
+  StratifiedGridSequence sequence({ true, true }, 4, 1);
+  std::vector<double> point(2);
+  for (std::size_t i = 0; i < sequence.numberOfCells(); ++i)
+    sequence.next(point.data());
+
+  // the centers of a 2 x 2 grid are 0.25 and 0.75
+  sequence.next(point.data());
+  BOOST_CHECK(point[0] != 0.25 && point[0] != 0.75);
+}
+
+BOOST_AUTO_TEST_CASE(unknown_sampling_mode_throws)
+{
+  BOOST_CHECK_THROW(makeUnitCubeSequence("sobol", std::vector<bool>(6, true), 10, 1), std::invalid_argument);
+  BOOST_CHECK(makeUnitCubeSequence("uniform", std::vector<bool>(6, true), 10, 1));
+}
@@ -0,0 +1,107 @@
+#define BOOST_TEST_MODULE test_lru_cache
+
+#include <boost/test/included/unit_test.hpp>
+#include <string>
+#include <vector>
+#include "lru_cache.h"
+
+namespace
+{
+/* A key whose hash collides for every value, the cache has to tell the keys apart by comparing them. */
+struct CollidingHash
+{
+  std::size_t operator()(const std::vector<int>&) const
+  {
+    return 0;
+  }
+};
+}  // namespace
+
+BOOST_AUTO_TEST_CASE(find_inserted)
+{
+  LruCache<int, std::string> cache(2);
+  cache.insert(1, "one");
+
+  auto value = cache.find(1);
+  BOOST_REQUIRE(value);
+  BOOST_CHECK_EQUAL(*value, "one");
+  BOOST_CHECK(!cache.find(2));
+  BOOST_CHECK_EQUAL(cache.hits(), 1u);
+  BOOST_CHECK_EQUAL(cache.misses(), 1u);
+}
+
+BOOST_AUTO_TEST_CASE(evicts_least_recently_used)
+{
+  LruCache<int, int> cache(2);
+  cache.insert(1, 10);
+  cache.insert(2, 20);
+
+  // using 1 makes 2 the least recently used value
+  BOOST_CHECK(cache.find(1));
+  cache.insert(3, 30);
+
+  BOOST_CHECK_EQUAL(cache.size(), 2u);
+  BOOST_CHECK(cache.find(1));
+  BOOST_CHECK(!cache.find(2));
+  BOOST_CHECK(cache.find(3));
+}
+
+BOOST_AUTO_TEST_CASE(insert_replaces)
+{
+  LruCache<int, int> cache(2);
+  cache.insert(1, 10);
+  cache.insert(2, 20);
+  cache.insert(1, 11);
+  cache.insert(3, 30);
+
+  BOOST_CHECK_EQUAL(cache.size(), 2u);
+  BOOST_REQUIRE(cache.find(1));
+  BOOST_CHECK_EQUAL(*cache.find(1), 11);
+  BOOST_CHECK(!cache.find(2));
+}
+
+BOOST_AUTO_TEST_CASE(invalid_values_are_removed)
+{
+  LruCache<int, int> cache(4);
+  cache.insert(1, 10);
+
+  BOOST_CHECK(!cache.find(1, [](int value) { return value > 10; }));
+  BOOST_CHECK_EQUAL(cache.invalidations(), 1u);
+  BOOST_CHECK_EQUAL(cache.size(), 0u);
+  BOOST_CHECK(!cache.find(1));
+  BOOST_CHECK_EQUAL(cache.misses(), 2u);
+}
+
+BOOST_AUTO_TEST_CASE(erase_and_capacity)
+{
+  LruCache<int, int> cache(3);
+  cache.insert(1, 10);
+  cache.insert(2, 20);
+  cache.insert(3, 30);
+
+  cache.erase(2);
+  cache.erase(4);
+  BOOST_CHECK_EQUAL(cache.size(), 2u);
+
+  cache.setCapacity(1);
+  BOOST_CHECK_EQUAL(cache.size(), 1u);
+  BOOST_CHECK(cache.find(3));
+
+  cache.setCapacity(0);
+  cache.insert(4, 40);
+  BOOST_CHECK_EQUAL(cache.size(), 0u);
+  BOOST_CHECK(!cache.find(4));
+}
+
+BOOST_AUTO_TEST_CASE(colliding_hashes_keep_keys_apart)
+{
+  LruCache<std::vector<int>, int, CollidingHash> cache(4);
+  cache.insert({ 1, 2 }, 12);
+  cache.insert({ 2, 1 }, 21);
+
+  BOOST_REQUIRE(cache.find({ 1, 2 }));
+  BOOST_CHECK_EQUAL(*cache.find({ 1, 2 }), 12);
+  BOOST_REQUIRE(cache.find({ 2, 1 }));
+  BOOST_CHECK_EQUAL(*cache.find({ 2, 1 }), 21);
+  BOOST_CHECK(!cache.find({ 1, 1 }));
+}